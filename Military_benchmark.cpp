@@ -0,0 +1,333 @@
+// Military Management System - Microbenchmarks
+// Build: g++ -std=c++17 -O2 -pthread Military_benchmark.cpp -o Military_benchmark
+// Usage: Military_benchmark [--sizes 1000,10000,100000,1000000] [--min-time-ms 200] [--filter name]
+// Prints one JSON object per line: benchmark, dataset size, iterations, ns/op,
+// allocations/op and the process peak RSS so far, for comparing builds.
+#define MILITARY_NO_MAIN
+#include "Military_project_endofsemester.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// ------------------- Allocation counting -------------------
+// Global operator new/delete replacements backed by malloc/free. GCC cannot see that
+// the pair is replaced together once they are inlined, hence the pragma.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static atomic<uint64_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// ------------------- Peak RSS -------------------
+long peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;  // kilobytes on Linux
+#endif
+}
+
+// ------------------- Output sink -------------------
+// Swallows everything written to cout while display benchmarks run
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+static volatile uint64_t sink;  // keeps results of timed calls observable
+
+// ------------------- Runner -------------------
+struct BenchOptions {
+    vector<size_t> sizes = { 1000, 10000, 100000, 1000000 };
+    double minTimeMs = 200;
+    string filter;
+};
+
+bool selected(const BenchOptions& options, const string& name) {
+    return options.filter.empty() || name.find(options.filter) != string::npos;
+}
+
+void report(const string& name, size_t soldiers, uint64_t iterations, double elapsedNs, uint64_t allocs) {
+    printf("{\"benchmark\":\"%s\",\"soldiers\":%zu,\"iterations\":%llu,\"ns_per_op\":%.2f,"
+           "\"allocs_per_op\":%.3f,\"peak_rss_kb\":%ld}\n",
+           name.c_str(), soldiers, static_cast<unsigned long long>(iterations), elapsedNs / iterations,
+           static_cast<double>(allocs) / iterations, peakRssKb());
+    fflush(stdout);
+}
+
+// Times op(i) in doubling batches until one batch runs for at least minTimeMs,
+// then reports that batch.
+template <typename Op>
+void measure(const BenchOptions& options, const string& name, size_t soldiers, Op op) {
+    if (!selected(options, name)) return;
+
+    uint64_t iterations = 1;
+    while (true) {
+        uint64_t allocsBefore = allocationCount.load(memory_order_relaxed);
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) op(i);
+        double elapsedNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        uint64_t allocs = allocationCount.load(memory_order_relaxed) - allocsBefore;
+
+        if (elapsedNs >= options.minTimeMs * 1e6 || iterations >= (uint64_t(1) << 32)) {
+            report(name, soldiers, iterations, elapsedNs, allocs);
+            return;
+        }
+        iterations *= 2;
+    }
+}
+
+// ------------------- Benchmarks -------------------
+// Soldier-count dependent: lookups, assignment and per-soldier display
+void runRosterBenchmarks(const BenchOptions& options, size_t count) {
+    auto system = make_unique<MilitaryManagementSystem>();
+    vector<string> ids(count);
+    for (size_t i = 0; i < count; ++i) {
+        ids[i] = "S" + to_string(i);
+        MilitaryRank rank("Sergeant", 1 + static_cast<int>(i % 20), static_cast<AccessLevel>(1 + i % 4),
+                          static_cast<MilitaryBranch>(i % 6));
+        system->addSoldier(Soldier(ids[i], "First", "Last", rank, "Infantry", static_cast<int>(i % 30)));
+    }
+
+    // Visit soldiers in random order so lookups are not cache-friendly by accident
+    vector<uint32_t> order(min<size_t>(count, 1 << 20));
+    mt19937 rng(42);
+    for (auto& o : order) o = static_cast<uint32_t>(rng() % count);
+    auto pick = [&](uint64_t i) -> const string& { return ids[order[i % order.size()]]; };
+
+    measure(options, "login", count, [&](uint64_t i) { sink = sink + system->login(pick(i)); });
+
+    // Display runs before assignment grows the loadouts
+    NullBuffer nullBuffer;
+    streambuf* console = cout.rdbuf(&nullBuffer);
+    system->login(ids[0]);
+    measure(options, "display_soldier", count, [&](uint64_t) { sink = sink + system->displaySoldierInfo(); });
+    measure(options, "report_roster", count, [&](uint64_t) {
+        istringstream script("report roster -\n");
+        sink = sink + system->runBatch(script).succeeded;
+    });
+
+    // Plans (without issuing) against 32 stocked weapon types spread over 4 types
+    string stock;
+    for (int w = 0; w < 32; ++w) {
+        stock += "add_weapon W" + to_string(w) + " Type" + to_string(w % 4) + " " + to_string(20 + w) + " " +
+                 to_string(100 + 10 * w) + " " + to_string(50 + w) + " " + to_string(1 + w % 4) + " " +
+                 to_string(count / 8) + "\n";
+    }
+    istringstream stockScript(stock);
+    system->runBatch(stockScript);
+    measure(options, "optimize_loadout_force", count, [&](uint64_t) {
+        istringstream script("optimize_loadout force limit=0\n");
+        sink = sink + system->runBatch(script).succeeded;
+    });
+    cout.rdbuf(console);
+
+    measure(options, "assign_weapon", count, [&](uint64_t i) {
+        sink = sink + static_cast<uint64_t>(system->assignWeapon(pick(i), "Rifle"));
+    });
+}
+
+// Deployment planning over 200 warzones with capacities and skill requirements:
+// a whole-force solve, a warzone change and a withdrawal with its re-deployment
+void runDeploymentBenchmarks(const BenchOptions& options, size_t count) {
+    static const char* skills[] = { "Medic", "Pilot", "Sniper", "Engineer", "Diver", "Signals", "Driver", "Linguist" };
+    const size_t zones = 200;
+    if (!selected(options, "deploy_force") && !selected(options, "set_warzone") && !selected(options, "withdraw_redeploy")) return;
+    auto system = make_unique<MilitaryManagementSystem>();
+    mt19937 rng(42);
+    for (size_t i = 0; i < count; ++i) {
+        MilitaryRank rank("Sergeant", 1 + static_cast<int>(i % 20), static_cast<AccessLevel>(1 + rng() % 4),
+                          static_cast<MilitaryBranch>(i % 6));
+        Soldier soldier("S" + to_string(i), "First", "Last", rank, "Infantry", static_cast<int>(i % 30));
+        for (size_t k = rng() % 4; k > 0; --k) soldier.addSkill(skills[rng() % 8]);
+        system->addSoldier(move(soldier));
+    }
+    auto requirement = [&] {
+        string list;
+        for (size_t k = rng() % 3; k > 0; --k) list += string(list.empty() ? " skills=" : ";") + skills[rng() % 8];
+        return list;
+    };
+    string setup = "login S0\n";
+    for (size_t z = 0; z < zones; ++z) {
+        string id = "W" + to_string(z);
+        setup += "add_warzone " + id + " Name Place Text " + to_string(1 + rng() % 4) + "\n";
+        setup += "set_warzone " + id + " capacity=" + to_string(count / zones * 3 / 4 + rng() % (count / zones + 1)) + requirement() + "\n";
+    }
+    setup += "deploy force\n";  // the timed calls re-plan a full pool
+    vector<string> changes(256), moves(256);
+    for (string& change : changes) {
+        change = "set_warzone W" + to_string(rng() % zones) + " capacity=" + to_string(count / zones * 3 / 4 + rng() % (count / zones + 1)) +
+                 requirement() + "\n";
+    }
+    for (string& move : moves) {
+        string id = "S" + to_string(rng() % count);
+        move = "withdraw " + id + "\ndeploy " + id + "\n";
+    }
+
+    NullBuffer nullBuffer;
+    streambuf* console = cout.rdbuf(&nullBuffer);
+    istringstream setupScript(setup);
+    system->runBatch(setupScript);
+    auto run = [&](const string& commands) {
+        istringstream script(commands);
+        sink = sink + system->runBatch(script).succeeded;
+    };
+    measure(options, "deploy_force", count, [&](uint64_t) { run("deploy force\n"); });
+    measure(options, "set_warzone", count, [&](uint64_t i) { run(changes[i % changes.size()]); });
+    measure(options, "withdraw_redeploy", count, [&](uint64_t i) { run(moves[i % moves.size()]); });
+    cout.rdbuf(console);
+}
+
+// Independent of the roster size
+void runInventoryBenchmarks(const BenchOptions& options) {
+    const size_t kinds = 64;
+    WeaponCatalog catalog;
+    for (size_t i = 0; i < kinds; ++i) catalog.intern(Weapon("Weapon" + to_string(i), "Assault", 50, 300, 70));
+    Inventory inventory(catalog);
+    for (size_t i = 0; i < kinds; ++i) {
+        inventory.addWeapon(static_cast<WeaponId>(i), 1 << 30);
+        inventory.addSupply("SUP" + to_string(i), "Supply crate", 100);
+    }
+
+    measure(options, "inventory_add_weapon", 0, [&](uint64_t i) {
+        inventory.addWeapon(static_cast<WeaponId>(i % kinds), 1);
+    });
+    measure(options, "inventory_remove_weapon", 0, [&](uint64_t i) {
+        inventory.removeWeapon(static_cast<WeaponId>(i % kinds), 1);
+    });
+    measure(options, "inventory_get_weapon_quantity", 0, [&](uint64_t i) {
+        sink = sink + static_cast<uint64_t>(inventory.getWeaponQuantity(static_cast<WeaponId>(i % kinds)));
+    });
+    measure(options, "inventory_transaction", 0, [&](uint64_t i) {
+        InventoryTransaction transaction(inventory);
+        transaction.addWeapon(static_cast<WeaponId>(i % kinds), 3);
+        transaction.addWeapon(static_cast<WeaponId>((i + 7) % kinds), 1);
+        transaction.addSupply("SUP" + to_string(i % kinds), 10);
+        sink = sink + transaction.reserve();
+    });  // aborted on destruction, so stock stays level
+    measure(options, "inventory_to_string", 0, [&](uint64_t) { sink = sink + inventory.toString().size(); });
+
+    Weapon rifle("Rifle", "Assault", 50, 300, 70);
+    Weapon pistol("Pistol", "Sidearm", 30, 100, 80);
+    measure(options, "weapon_operator_plus", 0, [&](uint64_t) {
+        Weapon combined = rifle + pistol;
+        sink = sink + static_cast<uint64_t>(combined.getDamageRating());
+    });
+}
+
+// Warzone map queries over 100k zones spread evenly over the globe
+void runWarzoneMapBenchmarks(const BenchOptions& options) {
+    const size_t zones = 100000;
+    mt19937 rng(7);
+    uniform_real_distribution<double> unit(0, 1);
+    auto latitude = [&] { return asin(2 * unit(rng) - 1) * 180 / WarzoneMap::PI; };
+    auto longitude = [&] { return 360 * unit(rng) - 180; };
+    WarzoneMap map;
+    for (size_t i = 0; i < zones; ++i) {
+        map.set(static_cast<uint32_t>(i), static_cast<AccessLevel>(1 + i % 4), latitude(), longitude());
+    }
+    vector<pair<double, double>> origins(4096);
+    for (auto& o : origins) o = { latitude(), longitude() };
+    auto origin = [&](uint64_t i) { return origins[i % origins.size()]; };
+    sink = sink + map.nearest(0, 0, AccessLevel::SECRET, 1).size();  // builds the trees outside the timing
+
+    measure(options, "warzone_nearest_5", 0, [&](uint64_t i) {
+        sink = sink + map.nearest(origin(i).first, origin(i).second, AccessLevel::SECRET, 5).size();
+    });
+    measure(options, "warzone_within_500km", 0, [&](uint64_t i) {
+        sink = sink + map.nearest(origin(i).first, origin(i).second, AccessLevel::SECRET, SIZE_MAX, 500).size();
+    });
+}
+
+// Cost of recording one access decision: AuditTrail::check with the trail closed (one
+// relaxed load) and open (a copy into this thread's ring, with the drain on its own
+// thread). Recording is timed in bursts of half a ring with an untimed flush between
+// them, so every timed record is stored rather than dropped as a full ring would.
+void runAuditBenchmarks(const BenchOptions& options) {
+    static const char* soldierIds[] = { "S1", "S22", "S333", "S4444" };
+    auto check = [](uint64_t i) {
+        return AuditTrail::check(AuditKind::WEAPON, soldierIds[i % 4], "Rifle", AccessLevel::SECRET,
+                                 static_cast<AccessLevel>(1 + i % 4), i % 4 < 2);
+    };
+    measure(options, "audit_record_off", 0, [&](uint64_t i) { sink = sink + check(i); });
+
+    string name = "audit_record_on", path = "Military_benchmark_audit.bin";
+    AuditTrail& trail = AuditTrail::instance();
+    if (!selected(options, name) || !trail.open(path)) return;
+    const uint64_t burst = 2048;
+    uint64_t iterations = 0, allocs = 0;
+    double elapsedNs = 0;
+    while (elapsedNs < options.minTimeMs * 1e6) {
+        uint64_t allocsBefore = allocationCount.load(memory_order_relaxed);
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = iterations; i < iterations + burst; ++i) sink = sink + check(i);
+        elapsedNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        allocs += allocationCount.load(memory_order_relaxed) - allocsBefore;
+        iterations += burst;
+        trail.flush();
+    }
+    report(name, 0, iterations, elapsedNs, allocs);
+    if (trail.dropped()) printf("{\"benchmark\":\"%s\",\"dropped\":%llu}\n", name.c_str(),
+                                static_cast<unsigned long long>(trail.dropped()));
+    trail.close();
+    remove(path.c_str());
+    for (int n = 1; n < 8; ++n) remove((path + "." + to_string(n)).c_str());
+}
+
+// ------------------- Main -------------------
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "--sizes") {
+            options.sizes.clear();
+            stringstream list(value);
+            string item;
+            while (getline(list, item, ',')) options.sizes.push_back(stoul(item));
+        } else if (flag == "--min-time-ms") {
+            options.minTimeMs = stod(value);
+        } else if (flag == "--filter") {
+            options.filter = value;
+        } else {
+            cerr << "Unknown option: " << flag << "\n";
+            return 1;
+        }
+    }
+
+    runInventoryBenchmarks(options);
+    runWarzoneMapBenchmarks(options);
+    runAuditBenchmarks(options);
+    for (size_t count : options.sizes) {
+        if (count > 0) runRosterBenchmarks(options, count);
+        if (count > 0) runDeploymentBenchmarks(options, count);
+    }
+    return 0;
+}
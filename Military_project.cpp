@@ -7,11 +7,15 @@
 #include <string>
 #include <memory>
 #include <algorithm>
+#include <unordered_map>
 using namespace std;
 
 // ------------------- Enumerations -------------------
 enum class AccessLevel { CONFIDENTIAL = 1, SECRET, TOP_SECRET, SCI };
 
+const int ACCESS_LEVEL_COUNT = 4;
+const int MAX_ENLISTED_RANK_LEVEL = 10, MAX_RANK_LEVEL = 20;  // 1-10 enlisted, 11-20 officers
+
 // ------------------- Abstract Base Class -------------------
 class Person {
 protected:
@@ -37,6 +41,7 @@ public:
     }
 
     AccessLevel getAccessLevel() const { return accessLevel; }
+    int getRankLevel() const { return rankLevel; }
 
     friend ostream& operator<<(ostream& os, const MilitaryRank& rank) {
         os << rank.name << " (Level " << rank.rankLevel << ")";
@@ -56,6 +61,8 @@ public:
         : name(n), type(t), damageRating(dmg), range(r), accuracy(acc), requiredAccess(al) {}
 
     string getName() const { return name; }
+    string getType() const { return type; }
+    int getDamageRating() const { return damageRating; }
     AccessLevel getRequiredAccess() const { return requiredAccess; }
 
     friend ostream& operator<<(ostream& os, const Weapon& w) {
@@ -66,7 +73,21 @@ public:
 };
 
 // ------------------- Soldier -------------------
+class Unit;
+
+// A soldier's place in the unit tree: the unit and the position in its member list.
+// Copies start outside any unit, so a copied soldier never claims someone else's slot.
+struct UnitLink {
+    Unit* unit = nullptr;
+    size_t slot = 0;
+
+    UnitLink() = default;
+    UnitLink(const UnitLink&) {}
+    UnitLink& operator=(const UnitLink&) { return *this; }
+};
+
 class Soldier : public Person {
+    friend class Unit;
 protected:
     string id;
     MilitaryRank rank;
@@ -75,24 +96,17 @@ protected:
     bool active;
     vector<string> skills;
     vector<Weapon> assignedWeapons;
+    UnitLink unitLink;
 
 public:
     Soldier(string i, string fn, string ln, MilitaryRank r, string spec = "Infantry", int exp = 0)
         : Person(fn, ln), id(i), rank(r), specialization(spec), experienceYears(exp), active(true) {}
+    ~Soldier() override;
 
     void addSkill(const string& skill) { skills.push_back(skill); }
 
-    void assignWeapon(const Weapon& weapon) {
-        if ((int)rank.getAccessLevel() >= (int)weapon.getRequiredAccess())
-            assignedWeapons.push_back(weapon);
-        else
-            cout << "Access Denied: Weapon " << weapon.getName() << endl;
-    }
-
-    void removeWeapon(const string& weaponName) {
-        assignedWeapons.erase(remove_if(assignedWeapons.begin(), assignedWeapons.end(),
-            [&weaponName](Weapon& w) { return w.getName() == weaponName; }), assignedWeapons.end());
-    }
+    void assignWeapon(const Weapon& weapon);       // defined after Unit: they update the unit roll-ups
+    void removeWeapon(const string& weaponName);
 
     void display() const override {
         cout << "Soldier: " << firstName << " " << lastName << " | ID: " << id
@@ -103,7 +117,11 @@ public:
     }
 
     AccessLevel getAccessLevel() const { return rank.getAccessLevel(); }
+    int getRankLevel() const { return rank.getRankLevel(); }
+    int getExperienceYears() const { return experienceYears; }
+    const vector<Weapon>& getWeapons() const { return assignedWeapons; }
     string getId() const { return id; }
+    Unit* getUnit() const { return unitLink.unit; }  // O(1), null if unassigned
 
     Soldier operator+(const Soldier& other) const {
         Soldier merged = *this;
@@ -112,22 +130,184 @@ public:
     }
 };
 
+// ------------------- UnitRollup -------------------
+// Readiness totals for a unit and everything below it
+enum RankBand { JUNIOR_ENLISTED, NCO, JUNIOR_OFFICER, SENIOR_OFFICER, RANK_BAND_COUNT };
+
+// Enlisted and officer ranks are each split in half, so the two never share a band
+inline RankBand rankBand(int rankLevel) {
+    if (rankLevel <= MAX_ENLISTED_RANK_LEVEL) {
+        return rankLevel <= MAX_ENLISTED_RANK_LEVEL / 2 ? JUNIOR_ENLISTED : NCO;
+    }
+    return rankLevel <= (MAX_ENLISTED_RANK_LEVEL + MAX_RANK_LEVEL) / 2 ? JUNIOR_OFFICER : SENIOR_OFFICER;
+}
+
+struct UnitRollup {
+    int headCount = 0;
+    int byRankBand[RANK_BAND_COUNT] = {};
+    int byAccessLevel[ACCESS_LEVEL_COUNT] = {};  // index = level - 1
+    long long experienceYears = 0;
+    long long totalDamage = 0;
+    unordered_map<string, int> weaponsByType;
+
+    void addWeapon(const Weapon& w, int sign) {
+        totalDamage += sign * w.getDamageRating();
+        int& count = weaponsByType[w.getType()];
+        count += sign;
+        if (count == 0) weaponsByType.erase(w.getType());
+    }
+
+    void addSoldier(const Soldier& s, int sign) {
+        headCount += sign;
+        byRankBand[rankBand(s.getRankLevel())] += sign;
+        byAccessLevel[static_cast<int>(s.getAccessLevel()) - 1] += sign;
+        experienceYears += sign * s.getExperienceYears();
+        for (const Weapon& w : s.getWeapons()) addWeapon(w, sign);
+    }
+
+    void addRollup(const UnitRollup& other, int sign) {
+        headCount += sign * other.headCount;
+        for (int i = 0; i < RANK_BAND_COUNT; ++i) byRankBand[i] += sign * other.byRankBand[i];
+        for (int i = 0; i < ACCESS_LEVEL_COUNT; ++i) byAccessLevel[i] += sign * other.byAccessLevel[i];
+        experienceYears += sign * other.experienceYears;
+        totalDamage += sign * other.totalDamage;
+        for (const auto& [type, count] : other.weaponsByType) {
+            int& total = weaponsByType[type];
+            total += sign * count;
+            if (total == 0) weaponsByType.erase(type);
+        }
+    }
+
+    double averageExperience() const { return headCount ? double(experienceYears) / headCount : 0.0; }
+
+    int weaponCount(const string& type) const {
+        auto it = weaponsByType.find(type);
+        return it != weaponsByType.end() ? it->second : 0;
+    }
+};
+
 // ------------------- Unit -------------------
+// Node of the organisational tree (unit -> sub-units -> soldiers). Members and sub-units
+// are kept in vectors, and each soldier or sub-unit remembers its position, so adding,
+// removing and transferring are O(1) swap-and-pop operations. Walks over a subtree
+// follow parent pointers instead of keeping a stack, so they never allocate.
+// Units and soldiers do not own each other; whichever is destroyed first detaches.
+// Every unit keeps a UnitRollup of its whole subtree, updated along the path to the
+// root on each change, so readiness reads never rescan the members.
 class Unit {
+    friend class Soldier;
 private:
     string id, name;
     Soldier* commander = nullptr;
     vector<Soldier*> members;
     AccessLevel clearance;
+    Unit* parent = nullptr;
+    size_t parentSlot = 0;  // position in parent->subUnits
+    vector<Unit*> subUnits;
+    UnitRollup rollup;  // this unit and all sub-units
+
+    // Applies a change to this unit and all of its ancestors, O(depth)
+    template <typename F>
+    void propagate(F change) {
+        for (Unit* u = this; u; u = u->parent) change(u->rollup);
+    }
+
+    void detachMember(Soldier* s) {
+        propagate([&](UnitRollup& r) { r.addSoldier(*s, -1); });
+        size_t slot = s->unitLink.slot;
+        members[slot] = members.back();
+        members[slot]->unitLink.slot = slot;
+        members.pop_back();
+        s->unitLink.unit = nullptr;
+    }
+
+    void detachSubUnit(Unit* child) {
+        propagate([&](UnitRollup& r) { r.addRollup(child->rollup, -1); });
+        size_t slot = child->parentSlot;
+        subUnits[slot] = subUnits.back();
+        subUnits[slot]->parentSlot = slot;
+        subUnits.pop_back();
+        child->parent = nullptr;
+    }
+
 public:
     Unit(string i, string n, AccessLevel cl = AccessLevel::CONFIDENTIAL)
         : id(i), name(n), clearance(cl) {}
+    Unit(const Unit&) = delete;
+    Unit& operator=(const Unit&) = delete;
+
+    ~Unit() {
+        for (Soldier* m : members) m->unitLink.unit = nullptr;
+        for (Unit* child : subUnits) child->parent = nullptr;
+        if (parent) parent->detachSubUnit(this);
+    }
+
+    string getId() const { return id; }
+    string getName() const { return name; }
+    Unit* getParent() const { return parent; }
+    size_t memberCount() const { return members.size(); }  // direct members only
+    const UnitRollup& getRollup() const { return rollup; }  // includes sub-units
 
     void setCommander(Soldier* s) { commander = s; }
-    void addMember(Soldier* s) { members.push_back(s); }
-    void removeMember(const string& soldierId) {
-        members.erase(remove_if(members.begin(), members.end(),
-            [&soldierId](Soldier* s) { return s->getId() == soldierId; }), members.end());
+
+    // Moves the soldier here from whatever unit it was in
+    void addMember(Soldier* s) {
+        if (s->unitLink.unit == this) return;
+        if (s->unitLink.unit) s->unitLink.unit->detachMember(s);
+        s->unitLink.unit = this;
+        s->unitLink.slot = members.size();
+        members.push_back(s);
+        propagate([&](UnitRollup& r) { r.addSoldier(*s, +1); });
+    }
+
+    void removeMember(Soldier* s) {
+        if (s->unitLink.unit == this) detachMember(s);
+    }
+
+    static void transfer(Soldier* s, Unit& to) { to.addMember(s); }
+
+    // Attaches (or moves) a unit below this one; refuses to create a cycle. O(depth).
+    bool addSubUnit(Unit* child) {
+        for (const Unit* u = this; u; u = u->parent) {
+            if (u == child) {
+                cout << "Cannot place unit " << child->name << " under its own sub-unit " << name << endl;
+                return false;
+            }
+        }
+        if (child->parent) child->parent->detachSubUnit(child);
+        child->parent = this;
+        child->parentSlot = subUnits.size();
+        subUnits.push_back(child);
+        propagate([&](UnitRollup& r) { r.addRollup(child->rollup, +1); });
+        return true;
+    }
+
+    void removeSubUnit(Unit* child) {
+        if (child->parent == this) detachSubUnit(child);
+    }
+
+    // Visits this unit and every unit below it, parents before children.
+    // The visitor must not restructure the tree.
+    template <typename F>
+    void forEachUnit(F visit) const {
+        const Unit* u = this;
+        while (u) {
+            visit(*u);
+            if (!u->subUnits.empty()) {
+                u = u->subUnits[0];
+                continue;
+            }
+            while (u != this && u->parentSlot + 1 >= u->parent->subUnits.size()) u = u->parent;
+            u = (u == this) ? nullptr : u->parent->subUnits[u->parentSlot + 1];
+        }
+    }
+
+    // Visits every soldier in this unit and its sub-units
+    template <typename F>
+    void forEachMember(F visit) const {
+        forEachUnit([&](const Unit& u) {
+            for (Soldier* m : u.members) visit(m);
+        });
     }
 
     void display() const {
@@ -140,9 +320,45 @@ public:
             cout << "Member: ";
             m->display();
         }
+        for (auto* child : subUnits) {
+            cout << "Sub-unit of " << name << ": ";
+            child->display();
+        }
+    }
+
+    void displayReadiness() const {
+        static const char* bandNames[RANK_BAND_COUNT] = { "Junior enlisted", "NCO", "Junior officer", "Senior officer" };
+        cout << "Readiness of " << name << ": " << rollup.headCount << " soldiers, average experience "
+             << rollup.averageExperience() << " years, total damage rating " << rollup.totalDamage << endl;
+        for (int i = 0; i < RANK_BAND_COUNT; ++i) cout << "  " << bandNames[i] << ": " << rollup.byRankBand[i] << endl;
+        for (int i = 0; i < ACCESS_LEVEL_COUNT; ++i) cout << "  Access level " << i + 1 << ": " << rollup.byAccessLevel[i] << endl;
+        for (const auto& [type, count] : rollup.weaponsByType) cout << "  " << type << " weapons: " << count << endl;
     }
 };
 
+Soldier::~Soldier() {
+    if (unitLink.unit) unitLink.unit->removeMember(this);
+}
+
+void Soldier::assignWeapon(const Weapon& weapon) {
+    if ((int)rank.getAccessLevel() >= (int)weapon.getRequiredAccess()) {
+        assignedWeapons.push_back(weapon);
+        if (unitLink.unit) unitLink.unit->propagate([&](UnitRollup& r) { r.addWeapon(weapon, +1); });
+    } else {
+        cout << "Access Denied: Weapon " << weapon.getName() << endl;
+    }
+}
+
+void Soldier::removeWeapon(const string& weaponName) {
+    if (unitLink.unit) {
+        for (const Weapon& w : assignedWeapons) {
+            if (w.getName() == weaponName) unitLink.unit->propagate([&](UnitRollup& r) { r.addWeapon(w, -1); });
+        }
+    }
+    assignedWeapons.erase(remove_if(assignedWeapons.begin(), assignedWeapons.end(),
+        [&weaponName](Weapon& w) { return w.getName() == weaponName; }), assignedWeapons.end());
+}
+
 // ------------------- Inventory -------------------
 class Inventory {
 private:
@@ -234,6 +450,18 @@ int main() {
     unit1.addMember(alice);
     unit1.addMember(bob);
 
+    Unit unit2("U002", "Bravo");
+    unit1.addSubUnit(&unit2);
+    Unit::transfer(alice, unit2);
+    cout << "Alice is in unit " << alice->getUnit()->getName() << endl;
+
+    size_t headCount = 0;
+    unit1.forEachMember([&](Soldier*) { ++headCount; });
+    cout << "Alpha head count (with sub-units): " << headCount << endl;
+    unit1.displayReadiness();
+    alice->removeWeapon("Rifle");
+    cout << "Assault weapons in Alpha after Alice returns her rifle: " << unit1.getRollup().weaponCount("Assault") << endl;
+
     // Display
     alice->display();
     bob->display();
@@ -1,15 +1,981 @@
+// Before any include: windows.h (also pulled in by some MinGW thread headers) would
+// otherwise define min/max macros over std::min/std::max and numeric_limits<>::max()
+#if defined(_WIN32) && !defined(NOMINMAX)
+#define NOMINMAX
+#endif
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <climits>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <string_view>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <charconv>
+#include <future>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
 // ------------------- Enumerations -------------------
-enum class AccessLevel { CONFIDENTIAL = 1, SECRET, TOP_SECRET, SCI };
-enum class MilitaryBranch { ARMY, NAVY, AIR_FORCE, MARINES, COAST_GUARD, SPACE_FORCE };
+enum class AccessLevel : uint8_t { CONFIDENTIAL = 1, SECRET, TOP_SECRET, SCI };
+enum class MilitaryBranch : uint8_t { ARMY, NAVY, AIR_FORCE, MARINES, COAST_GUARD, SPACE_FORCE };
+
+const int ACCESS_LEVEL_COUNT = 4;
+const int BRANCH_COUNT = 6;
+const int MIN_RANK_LEVEL = 1, MAX_RANK_LEVEL = 20;
+const AccessLevel FORCE_REPORT_ACCESS = AccessLevel::TOP_SECRET;  // roster and loadout reports cover everyone
+const AccessLevel AUDIT_ACCESS = AccessLevel::SCI;                 // reading other soldiers' access decisions
+const size_t CLIENT_TARGET_LIMIT = 1000;  // soldiers one server client's deploy or optimize_loadout may cover
+
+inline bool isValidAccessLevel(int level) {
+    return level >= static_cast<int>(AccessLevel::CONFIDENTIAL) && level <= static_cast<int>(AccessLevel::SCI);
+}
+
+inline bool isValidBranch(int branch) { return branch >= 0 && branch < BRANCH_COUNT; }  // enum value, not the 1-6 prompt
+inline bool isValidRankLevel(int level) { return level >= MIN_RANK_LEVEL && level <= MAX_RANK_LEVEL; }
+
+// ------------------- Platform helpers -------------------
+// Flushes a stdio file all the way to disk
+bool syncFile(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Atomically replaces 'path' with 'tmpPath' (which must already be synced)
+bool replaceFile(const string& tmpPath, const string& path) {
+#ifdef _WIN32
+    return MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) return false;
+    // Make the rename itself durable
+    size_t slash = path.find_last_of('/');
+    string dir = (slash == string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+    return true;
+#endif
+}
+
+// ------------------- Journal -------------------
+// Append-only log of mutations since the last snapshot. Each record is framed as
+// [payload length][CRC-32 of payload][payload], where the payload is an op code
+// followed by its little-endian fields. Appends only buffer; commit() makes them
+// durable, and whichever caller gets there first writes and fsyncs everything
+// pending, so concurrent and batched callers share one fsync per group. A failed
+// write leaves a torn frame that replay would cut everything after, so the journal
+// refuses further records until reset() starts a new one after a snapshot.
+enum class JournalOp : uint8_t {
+    ADD_WEAPON = 1,     // weapon id, quantity
+    REMOVE_WEAPON,      // weapon id, quantity
+    ADD_SUPPLY,         // supply id, description, quantity
+    REMOVE_SUPPLY,      // supply id, quantity
+    ASSIGN_WEAPON,      // soldier id, weapon id
+    CREATE_SOLDIER,     // id, first, last, rank name, rank level, access, branch, specialization, experience
+    DEFINE_WEAPON,      // expected weapon id, name, type, damage, range, accuracy, access
+    ADD_WARZONE,        // id, name, location, description, access
+    ADD_SKILL,          // soldier id, skill
+    ASSIGN_UNIT,        // soldier id, unit name
+    PROMOTE,            // soldier id, rank name, rank level
+    WARZONE_LIMITS,     // warzone id, capacity, required skills separated by ';'
+    DEPLOY,             // soldier id, state (0 withdrawn, 1 waiting, 2 deployed), warzone id
+    WARZONE_POSITION    // warzone id, latitude, longitude (NaN = removed from the map)
+};
+
+const char JOURNAL_MAGIC[8] = { 'M', 'I', 'L', 'J', 'R', 'N', 'L', '\0' };
+const size_t JOURNAL_HEADER_SIZE = 16;  // magic + snapshot epoch
+const size_t JOURNAL_GROUP_SIZE = 4096; // records per group commit in batch mode
+
+uint32_t crc32(const char* data, size_t length) {
+    struct Table {
+        uint32_t entries[256];
+    };
+    static const Table table = [] {  // built once, also when first called from several threads
+        Table built;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            built.entries[i] = c;
+        }
+        return built;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table.entries[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Decodes the fields of one record payload; reading past the end marks it bad
+class JournalReader {
+private:
+    const char* pos;
+    const char* end;
+    bool good = true;
+public:
+    JournalReader(const char* data, size_t length) : pos(data), end(data + length) {}
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        if (end - pos < 4) {
+            good = false;
+            return 0;
+        }
+        memcpy(&value, pos, 4);
+        pos += 4;
+        return value;
+    }
+    int32_t i32() { return static_cast<int32_t>(u32()); }
+    double f64() {
+        double value = 0;
+        if (end - pos < 8) {
+            good = false;
+            return 0;
+        }
+        memcpy(&value, pos, 8);
+        pos += 8;
+        return value;
+    }
+    string str() {
+        uint32_t length = u32();
+        if (static_cast<size_t>(end - pos) < length) {
+            good = false;
+            return string();
+        }
+        string value(pos, length);
+        pos += length;
+        return value;
+    }
+    bool ok() const { return good && pos == end; }
+};
+
+class Journal {
+private:
+    string path;
+    FILE* file = nullptr;
+    mutex lock;
+    condition_variable flushed;
+    string pending;             // encoded records not yet written
+    size_t pendingCount = 0;
+    uint64_t lastLsn = 0;       // sequence number of the last appended record
+    uint64_t durableLsn = 0;    // everything up to here is on disk
+    bool flushing = false;
+    bool failed = false;        // a group write failed, see reset()
+
+    static void encode(string& out, uint32_t value) { out.append(reinterpret_cast<const char*>(&value), 4); }
+    static void encode(string& out, int32_t value) { encode(out, static_cast<uint32_t>(value)); }
+    static void encode(string& out, double value) { out.append(reinterpret_cast<const char*>(&value), 8); }
+    static void encode(string& out, const string& value) {
+        encode(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    bool writeHeader(uint64_t epoch) {
+        char header[JOURNAL_HEADER_SIZE];
+        memcpy(header, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        memcpy(header + sizeof(JOURNAL_MAGIC), &epoch, sizeof(epoch));
+        return fwrite(header, 1, sizeof(header), file) == sizeof(header) && syncFile(file);
+    }
+
+public:
+    Journal() {}
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    ~Journal() {
+        if (file) {
+            commit(lastLsn);
+            fclose(file);
+        }
+    }
+
+    // Opens the journal for 'epoch' (the snapshot it sits on top of) and replays its
+    // records through apply(op, reader). A journal from an older epoch is already covered
+    // by the snapshot and is discarded; one from a newer epoch belongs to a later snapshot
+    // and is refused. A torn or corrupt tail is cut off at the last good record.
+    // Returns the number of replayed records, or -1 if the file cannot be used.
+    template <typename Apply>
+    long long open(const string& journalPath, uint64_t epoch, Apply apply) {
+        path = journalPath;
+        string contents;
+        if (FILE* existing = fopen(path.c_str(), "rb")) {
+            char buffer[1 << 16];
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof(buffer), existing)) > 0) contents.append(buffer, n);
+            fclose(existing);
+        }
+
+        uint64_t fileEpoch = 0;
+        bool usable = contents.size() >= JOURNAL_HEADER_SIZE &&
+                      memcmp(contents.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0;
+        if (usable) memcpy(&fileEpoch, contents.data() + sizeof(JOURNAL_MAGIC), sizeof(fileEpoch));
+        if (usable && fileEpoch > epoch) return -1;  // written after a newer snapshot than the one loaded
+        if (!usable || fileEpoch < epoch) {
+            return reset(epoch) ? 0 : -1;
+        }
+
+        long long replayed = 0;
+        size_t offset = JOURNAL_HEADER_SIZE;
+        while (contents.size() - offset >= 8) {
+            uint32_t length, crc;
+            memcpy(&length, contents.data() + offset, 4);
+            memcpy(&crc, contents.data() + offset + 4, 4);
+            if (length == 0 || contents.size() - offset - 8 < length) break;
+            const char* payload = contents.data() + offset + 8;
+            if (crc32(payload, length) != crc) break;
+            JournalReader reader(payload + 1, length - 1);
+            apply(static_cast<JournalOp>(payload[0]), reader);
+            offset += 8 + length;
+            ++replayed;
+        }
+
+        if (offset != contents.size()) {  // drop the torn tail before appending after it
+            string tmpPath = path + ".tmp";
+            FILE* tmp = fopen(tmpPath.c_str(), "wb");
+            bool ok = tmp && fwrite(contents.data(), 1, offset, tmp) == offset && syncFile(tmp);
+            if (tmp) fclose(tmp);
+            if (!ok || !replaceFile(tmpPath, path)) return -1;
+        }
+        file = fopen(path.c_str(), "ab");
+        return file ? replayed : -1;
+    }
+
+    // Starts an empty journal for a new epoch (after a snapshot has been written)
+    bool reset(uint64_t epoch) {
+        unique_lock<mutex> guard(lock);
+        flushed.wait(guard, [&] { return !flushing; });
+        if (file) fclose(file);
+        pending.clear();
+        pendingCount = 0;
+        durableLsn = lastLsn;
+        file = fopen(path.c_str(), "wb");
+        failed = !file || !writeHeader(epoch);
+        return !failed;
+    }
+
+    // Buffers one record and returns its sequence number, or 0 once the journal has failed
+    template <typename... Fields>
+    uint64_t append(JournalOp op, const Fields&... fields) {
+        lock_guard<mutex> guard(lock);
+        if (failed) return 0;
+        size_t start = pending.size();
+        pending.append(8, '\0');
+        pending.push_back(static_cast<char>(op));
+        (encode(pending, fields), ...);
+        uint32_t length = static_cast<uint32_t>(pending.size() - start - 8);
+        uint32_t crc = crc32(pending.data() + start + 8, length);
+        memcpy(&pending[start], &length, 4);
+        memcpy(&pending[start + 4], &crc, 4);
+        ++pendingCount;
+        return ++lastLsn;
+    }
+
+    // Blocks until record 'lsn' is durable. The first caller to find no flush in
+    // progress writes the whole pending group with a single fsync; others wait for it.
+    bool commit(uint64_t lsn) {
+        unique_lock<mutex> guard(lock);
+        if (failed) return false;
+        while (durableLsn < lsn) {
+            if (flushing) {
+                flushed.wait(guard);
+                continue;
+            }
+            if (!file || failed) return false;
+            flushing = true;
+            string group;
+            group.swap(pending);
+            pendingCount = 0;
+            uint64_t upTo = lastLsn;
+            guard.unlock();
+            bool ok = fwrite(group.data(), 1, group.size(), file) == group.size() && syncFile(file);
+            guard.lock();
+            flushing = false;
+            if (ok) durableLsn = upTo;
+            failed = !ok;
+            flushed.notify_all();
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    bool commitAll() {
+        uint64_t lsn;
+        {
+            lock_guard<mutex> guard(lock);
+            lsn = lastLsn;
+        }
+        return commit(lsn);
+    }
+
+    size_t pendingRecords() {
+        lock_guard<mutex> guard(lock);
+        return pendingCount;
+    }
+
+};
+
+// ------------------- AuditTrail -------------------
+// Records every access-control decision, granted or denied. A check only copies a
+// fixed-size record into a ring buffer owned by its own thread (one producer, one
+// consumer, no locks), so recording costs a clock read and a release store. A
+// background thread drains the rings every AUDIT_DRAIN_INTERVAL (sooner once a ring is
+// half full) and appends the records to the audit file in compressed blocks; once the
+// file passes its size limit it is synced and rotated to <path>.1, <path>.2, ... and the
+// oldest is deleted. A record that finds its ring full is counted as dropped instead of
+// stalling the check.
+//
+// A block holds records sorted by time: a dictionary of the soldier IDs and resource
+// names it uses, then per record a varint time delta, two packed bytes and two varint
+// dictionary indexes (6-8 bytes instead of 64). The header carries the block's time
+// range, so searches skip blocks outside the requested range without reading them, and
+// blocks whose dictionary lacks the soldier without decoding a single record.
+enum class AuditKind : uint8_t { CLEARANCE, WEAPON, WARZONE, INVENTORY };
+const char* const AUDIT_KIND_NAMES[] = { "clearance", "weapon", "warzone", "inventory" };
+
+struct AuditRecord {
+    uint64_t timeNs;          // system clock, since the Unix epoch
+    AuditKind kind;
+    bool granted;
+    AccessLevel clearance;    // the soldier's
+    AccessLevel required;
+    uint8_t soldierLength, resourceLength;
+    uint16_t reserved;
+    char soldier[24];         // longer IDs and names are truncated
+    char resource[24];
+
+    string_view soldierId() const { return string_view(soldier, soldierLength); }
+    string_view resourceName() const { return string_view(resource, resourceLength); }
+};
+static_assert(sizeof(AuditRecord) == 64, "an audit record should fill one cache line");
+
+const char AUDIT_BLOCK_MAGIC[4] = { 'A', 'U', 'D', 'B' };
+const size_t AUDIT_BLOCK_HEADER_SIZE = 32;  // magic, payload bytes, record count, CRC-32, first and last time
+const size_t AUDIT_BLOCK_RECORDS = 4096;
+const chrono::milliseconds AUDIT_DRAIN_INTERVAL(50);
+
+// Days since 1970-01-01 of a Gregorian date and back (Howard Hinnant's algorithms)
+constexpr int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    const unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const unsigned shifted = (5 * dayOfYear + 2) / 153;  // months since March
+    day = dayOfYear - (153 * shifted + 2) / 5 + 1;
+    month = shifted < 10 ? shifted + 3 : shifted - 9;
+    year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2);
+}
+
+// "2026-10-16T08:30:00.250Z"
+string formatUtc(uint64_t timeNs) {
+    uint64_t seconds = timeNs / 1000000000;
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(static_cast<int64_t>(seconds / 86400), year, month, day);
+    unsigned secondOfDay = static_cast<unsigned>(seconds % 86400);
+    char text[40];
+    snprintf(text, sizeof(text), "%04lld-%02u-%02uT%02u:%02u:%02u.%03uZ", static_cast<long long>(year), month, day,
+             secondOfDay / 3600, secondOfDay / 60 % 60, secondOfDay % 60,
+             static_cast<unsigned>(timeNs / 1000000 % 1000));
+    return text;
+}
+
+// Accepts Unix seconds, YYYY-MM-DD or YYYY-MM-DDTHH:MM:SS[Z], all UTC
+bool parseUtc(const string& text, uint64_t& timeNs) {
+    uint64_t seconds = 0;
+    if (!text.empty() && text.find_first_not_of("0123456789") == string::npos) {
+        auto [end, ec] = from_chars(text.data(), text.data() + text.size(), seconds);
+        if (ec != errc() || end != text.data() + text.size()) return false;
+    } else {
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0, used = 0, more = 0;
+        if (sscanf(text.c_str(), "%4d-%2d-%2d%n", &year, &month, &day, &used) != 3) return false;
+        if (text[used] == 'T') {
+            if (sscanf(text.c_str() + used, "T%2d:%2d:%2d%n", &hour, &minute, &second, &more) != 3) return false;
+            used += more;
+        }
+        if (text[used] == 'Z') ++used;
+        if (static_cast<size_t>(used) != text.size() || year < 1970 || month < 1 || month > 12 || day < 1 ||
+            day > 31 || hour > 23 || minute > 59 || second > 60) {
+            return false;
+        }
+        seconds = static_cast<uint64_t>(daysFromCivil(year, month, day)) * 86400 + hour * 3600 + minute * 60 + second;
+    }
+    if (seconds > UINT64_MAX / 1000000000) return false;
+    timeNs = seconds * 1000000000;
+    return true;
+}
+
+class AuditTrail {
+public:
+    // Search filter; an empty soldier ID matches every soldier
+    struct Query {
+        string soldierId;
+        uint64_t fromNs = 0, toNs = UINT64_MAX;  // inclusive
+    };
+
+    static AuditTrail& instance() {
+        static AuditTrail trail;
+        return trail;
+    }
+
+    // Records one decision while the trail is open and returns 'granted', so that a
+    // check can be wrapped in place. Closed, it costs one relaxed load.
+    static bool check(AuditKind kind, string_view soldierId, string_view resource, AccessLevel clearance,
+                      AccessLevel required, bool granted) {
+        if (recording.load(memory_order_relaxed)) instance().record(kind, soldierId, resource, clearance, required, granted);
+        return granted;
+    }
+
+    AuditTrail() {}
+    AuditTrail(const AuditTrail&) = delete;
+    AuditTrail& operator=(const AuditTrail&) = delete;
+    ~AuditTrail() { close(); }
+
+    // Appends to 'auditPath' (rotating it away first if its last block is torn) and
+    // starts recording. Files are rotated past maxBytes and the newest 'keep' are kept.
+    bool open(const string& auditPath, uint64_t maxBytes = 16 << 20, int keep = 8) {
+        close();
+        lock_guard<mutex> guard(writeLock);
+        path = auditPath;
+        maxFileBytes = maxBytes;
+        keepFiles = max(keep, 2);
+        file = fopen(path.c_str(), "ab+");
+        if (!file) return false;
+        if (fseek(file, 0, SEEK_SET) != 0) return false;
+        uint64_t valid = 0;
+        char header[AUDIT_BLOCK_HEADER_SIZE];
+        while (fread(header, 1, sizeof(header), file) == sizeof(header) && memcmp(header, AUDIT_BLOCK_MAGIC, 4) == 0) {
+            uint32_t bytes;
+            memcpy(&bytes, header + 4, 4);
+            if (fseek(file, static_cast<long>(bytes), SEEK_CUR) != 0) break;
+            valid += sizeof(header) + bytes;
+        }
+        if (fseek(file, 0, SEEK_END) != 0) return false;
+        fileBytes = static_cast<uint64_t>(ftell(file));
+        if (valid != fileBytes && !rotate()) return false;  // keep the damaged file, start clean
+        opened = true;
+        failed = false;
+        drainer = thread([this] { run(); });
+        recording.store(true, memory_order_relaxed);
+        return true;
+    }
+
+    // Stops recording, writes out what was recorded and closes the file
+    void close() {
+        {
+            lock_guard<mutex> guard(writeLock);
+            if (!opened) return;
+            recording.store(false, memory_order_relaxed);
+            opened = false;
+        }
+        wake.notify_all();
+        drainer.join();
+        lock_guard<mutex> guard(writeLock);
+        drainLocked();
+        if (file) {
+            syncFile(file);
+            fclose(file);
+            file = nullptr;
+        }
+    }
+
+    bool isOpen() const { return recording.load(memory_order_relaxed); }
+
+    // Writes everything recorded so far to the file
+    bool flush() {
+        lock_guard<mutex> guard(writeLock);
+        return opened && drainLocked();
+    }
+
+    // Records lost to full rings since the start
+    uint64_t dropped() {
+        lock_guard<mutex> guard(registryLock);
+        uint64_t total = 0;
+        for (const auto& ring : rings) total += ring->dropped.load(memory_order_relaxed);
+        return total;
+    }
+
+    // Flushes, then visits the matching records from the oldest file to the current
+    // one, in time order within each block, until fn returns false. The files are read
+    // without writeLock, so the drain keeps emptying the rings meanwhile; it only puts
+    // off rotating until the search ends, and what it appends to the current file after
+    // the search started is not read. Returns false if the trail is not open.
+    template <typename Fn>
+    bool search(const Query& query, Fn fn) {
+        string currentPath;
+        int files;
+        uint64_t currentBytes;
+        {
+            lock_guard<mutex> guard(writeLock);
+            if (!opened) return false;
+            drainLocked();
+            ++activeSearches;
+            currentPath = path;
+            files = keepFiles;
+            currentBytes = fileBytes;
+        }
+        for (int n = files - 1; n >= 0; --n) {
+            if (!searchFile(n ? currentPath + "." + to_string(n) : currentPath, n ? UINT64_MAX : currentBytes, query, fn)) break;
+        }
+        lock_guard<mutex> guard(writeLock);
+        --activeSearches;
+        return true;
+    }
+
+private:
+    // Written by its owning thread only, read and emptied by the drain
+    struct Ring {
+        static const size_t CAPACITY = 4096;  // power of two
+        alignas(64) atomic<uint64_t> head{0};
+        uint64_t cachedTail = 0;              // the owner's last look at tail
+        uint64_t wokenAt = UINT64_MAX;        // tail when the owner last woke the drain
+        atomic<uint64_t> dropped{0};
+        alignas(64) atomic<uint64_t> tail{0};
+        atomic<bool> owned{true};             // cleared when the owning thread exits
+        alignas(64) AuditRecord slots[CAPACITY];
+    };
+
+    // Hands the ring back for reuse when its thread exits
+    struct RingLease {
+        Ring* ring = nullptr;
+        ~RingLease() {
+            if (ring) ring->owned.store(false, memory_order_release);
+        }
+    };
+
+    static inline atomic<bool> recording{false};
+
+    mutex registryLock;             // guards rings
+    vector<unique_ptr<Ring>> rings;  // never freed before the trail, leases point into them
+    mutex writeLock;                // guards everything below; the drain is the single consumer
+    condition_variable wake;
+    thread drainer;
+    bool opened = false;
+    bool failed = false;            // a write error was already reported
+    string path;
+    FILE* file = nullptr;
+    uint64_t fileBytes = 0, maxFileBytes = 0;
+    int keepFiles = 0;
+    int activeSearches = 0;         // rotation waits while files are being searched
+    vector<AuditRecord> batch;
+    unordered_map<string_view, uint32_t> dictionary;
+    vector<string_view> names;
+    vector<uint32_t> indexes;
+    string block;
+
+    Ring& localRing() {
+        thread_local RingLease lease;
+        if (!lease.ring) {
+            lock_guard<mutex> guard(registryLock);
+            for (auto& ring : rings) {
+                // Only drained ones, so a new thread does not start out with a full ring
+                if (!ring->owned.load(memory_order_acquire) &&
+                    ring->tail.load(memory_order_relaxed) == ring->head.load(memory_order_relaxed)) {
+                    ring->owned.store(true, memory_order_relaxed);
+                    lease.ring = ring.get();
+                    break;
+                }
+            }
+            if (!lease.ring) {
+                rings.push_back(make_unique<Ring>());
+                lease.ring = rings.back().get();
+            }
+        }
+        return *lease.ring;
+    }
+
+    void record(AuditKind kind, string_view soldierId, string_view resource, AccessLevel clearance,
+                AccessLevel required, bool granted) {
+        Ring& ring = localRing();
+        uint64_t head = ring.head.load(memory_order_relaxed);
+        if (head - ring.cachedTail == Ring::CAPACITY) {
+            ring.cachedTail = ring.tail.load(memory_order_acquire);
+            if (head - ring.cachedTail >= Ring::CAPACITY / 2 && ring.wokenAt != ring.cachedTail) {
+                ring.wokenAt = ring.cachedTail;  // busy thread: drain early, once per drain
+                wake.notify_one();
+            }
+            if (head - ring.cachedTail == Ring::CAPACITY) {
+                ring.dropped.store(ring.dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+                return;
+            }
+        }
+        AuditRecord& entry = ring.slots[head & (Ring::CAPACITY - 1)];
+        entry.timeNs = static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count());
+        entry.kind = kind;
+        entry.granted = granted;
+        entry.clearance = clearance;
+        entry.required = required;
+        entry.soldierLength = static_cast<uint8_t>(min(soldierId.size(), sizeof(entry.soldier)));
+        entry.resourceLength = static_cast<uint8_t>(min(resource.size(), sizeof(entry.resource)));
+        memcpy(entry.soldier, soldierId.data(), entry.soldierLength);
+        memcpy(entry.resource, resource.data(), entry.resourceLength);
+        ring.head.store(head + 1, memory_order_release);
+    }
+
+    void run() {
+        unique_lock<mutex> guard(writeLock);
+        while (opened) {
+            wake.wait_for(guard, AUDIT_DRAIN_INTERVAL);  // close() clears opened before notifying
+            if (!drainLocked() && !failed) {
+                cerr << "Audit trail: cannot write " << path << "\n";
+                failed = true;
+            }
+        }
+    }
+
+    // Moves everything the rings hold into the file; called with writeLock held
+    bool drainLocked() {
+        batch.clear();
+        {
+            lock_guard<mutex> guard(registryLock);
+            for (auto& ring : rings) {
+                uint64_t tail = ring->tail.load(memory_order_relaxed);
+                uint64_t head = ring->head.load(memory_order_acquire);
+                for (; tail != head; ++tail) batch.push_back(ring->slots[tail & (Ring::CAPACITY - 1)]);
+                ring->tail.store(head, memory_order_release);
+            }
+        }
+        if (batch.empty()) return true;
+        if (!file) return false;
+        sort(batch.begin(), batch.end(), [](const AuditRecord& a, const AuditRecord& b) { return a.timeNs < b.timeNs; });
+
+        bool ok = true;
+        for (size_t start = 0; start < batch.size() && file; start += AUDIT_BLOCK_RECORDS) {
+            encodeBlock(batch.data() + start, min(AUDIT_BLOCK_RECORDS, batch.size() - start));
+            if (fwrite(block.data(), 1, block.size(), file) != block.size()) ok = false;
+            fileBytes += block.size();
+            if (fileBytes >= maxFileBytes && activeSearches == 0 && !rotate()) ok = false;
+        }
+        return file && fflush(file) == 0 && ok;
+    }
+
+    string rotatedPath(int n) const { return path + "." + to_string(n); }
+
+    // <path>.k-1 is deleted, <path>.n becomes <path>.n+1 and <path> becomes <path>.1
+    bool rotate() {
+        syncFile(file);
+        fclose(file);
+        remove(rotatedPath(keepFiles - 1).c_str());
+        for (int n = keepFiles - 2; n >= 1; --n) rename(rotatedPath(n).c_str(), rotatedPath(n + 1).c_str());
+        bool ok = rename(path.c_str(), rotatedPath(1).c_str()) == 0;
+        file = fopen(path.c_str(), "ab+");
+        fileBytes = 0;
+        return ok && file;
+    }
+
+    static void putVarint(string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    static bool getVarint(const char*& pos, const char* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; pos < end && shift < 64; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*pos++);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Encodes 'count' time-sorted records into 'block', header first
+    void encodeBlock(const AuditRecord* records, size_t count) {
+        dictionary.clear();
+        names.clear();
+        indexes.clear();
+        auto intern = [&](string_view name) {
+            auto [it, added] = dictionary.try_emplace(name, static_cast<uint32_t>(names.size()));
+            if (added) names.push_back(name);
+            return it->second;
+        };
+        for (size_t i = 0; i < count; ++i) {
+            indexes.push_back(intern(records[i].soldierId()));
+            indexes.push_back(intern(records[i].resourceName()));
+        }
+
+        block.assign(AUDIT_BLOCK_HEADER_SIZE, '\0');
+        putVarint(block, names.size());
+        for (string_view name : names) {
+            putVarint(block, name.size());
+            block.append(name);
+        }
+        uint64_t previous = records[0].timeNs;
+        for (size_t i = 0; i < count; ++i) {
+            putVarint(block, records[i].timeNs - previous);
+            previous = records[i].timeNs;
+            block.push_back(static_cast<char>(static_cast<uint8_t>(records[i].kind) | (records[i].granted ? 0x80 : 0)));
+            block.push_back(static_cast<char>(static_cast<uint8_t>(records[i].clearance) << 4 |
+                                              static_cast<uint8_t>(records[i].required)));
+            putVarint(block, indexes[2 * i]);
+            putVarint(block, indexes[2 * i + 1]);
+        }
+
+        uint32_t bytes = static_cast<uint32_t>(block.size() - AUDIT_BLOCK_HEADER_SIZE);
+        uint32_t records32 = static_cast<uint32_t>(count);
+        uint32_t crc = crc32(block.data() + AUDIT_BLOCK_HEADER_SIZE, bytes);
+        memcpy(&block[0], AUDIT_BLOCK_MAGIC, 4);
+        memcpy(&block[4], &bytes, 4);
+        memcpy(&block[8], &records32, 4);
+        memcpy(&block[12], &crc, 4);
+        memcpy(&block[16], &records[0].timeNs, 8);
+        memcpy(&block[24], &records[count - 1].timeNs, 8);
+    }
+
+    // Reads blocks within the first 'limit' bytes; returns false once fn asked to stop.
+    // Reading ends at the first damaged block.
+    template <typename Fn>
+    static bool searchFile(const string& filePath, uint64_t limit, const Query& query, Fn& fn) {
+        FILE* in = fopen(filePath.c_str(), "rb");
+        if (!in) return true;
+        char header[AUDIT_BLOCK_HEADER_SIZE];
+        string payload;
+        bool more = true;
+        uint64_t offset = 0;
+        while (more && offset + sizeof(header) <= limit && fread(header, 1, sizeof(header), in) == sizeof(header) &&
+               memcmp(header, AUDIT_BLOCK_MAGIC, 4) == 0) {
+            uint32_t bytes, count, crc;
+            uint64_t first, last;
+            memcpy(&bytes, header + 4, 4);
+            offset += sizeof(header) + bytes;
+            if (offset > limit) break;
+            memcpy(&count, header + 8, 4);
+            memcpy(&crc, header + 12, 4);
+            memcpy(&first, header + 16, 8);
+            memcpy(&last, header + 24, 8);
+            if (last < query.fromNs || first > query.toNs) {
+                if (fseek(in, static_cast<long>(bytes), SEEK_CUR) != 0) break;
+                continue;
+            }
+            payload.resize(bytes);
+            if (bytes == 0 || fread(&payload[0], 1, bytes, in) != bytes || crc32(payload.data(), bytes) != crc) break;
+            more = decodeBlock(payload, count, first, query, fn);
+        }
+        fclose(in);
+        return more;
+    }
+
+    template <typename Fn>
+    static bool decodeBlock(const string& payload, uint32_t count, uint64_t time, const Query& query, Fn& fn) {
+        const char* pos = payload.data();
+        const char* end = pos + payload.size();
+        string_view wanted = string_view(query.soldierId).substr(0, sizeof(AuditRecord::soldier));
+        vector<string_view> words;
+        uint64_t size, length, wantedIndex = UINT64_MAX;
+        if (!getVarint(pos, end, size) || size > payload.size()) return true;
+        for (uint64_t i = 0; i < size; ++i) {
+            if (!getVarint(pos, end, length) || static_cast<uint64_t>(end - pos) < length) return true;
+            words.emplace_back(pos, length);
+            if (words.back() == wanted) wantedIndex = i;
+            pos += length;
+        }
+        if (!wanted.empty() && wantedIndex == UINT64_MAX) return true;  // soldier not in this block
+
+        for (uint32_t i = 0; i < count; ++i) {
+            uint64_t delta, soldier, resource;
+            if (!getVarint(pos, end, delta) || end - pos < 2) return true;
+            uint8_t flags = static_cast<uint8_t>(pos[0]), levels = static_cast<uint8_t>(pos[1]);
+            pos += 2;
+            if (!getVarint(pos, end, soldier) || !getVarint(pos, end, resource) || soldier >= size || resource >= size) {
+                return true;
+            }
+            time += delta;
+            if (time < query.fromNs || time > query.toNs || (!wanted.empty() && soldier != wantedIndex)) continue;
+            AuditRecord entry = {};
+            entry.timeNs = time;
+            entry.kind = static_cast<AuditKind>(flags & 0x7F);
+            entry.granted = (flags & 0x80) != 0;
+            entry.clearance = static_cast<AccessLevel>(levels >> 4);
+            entry.required = static_cast<AccessLevel>(levels & 0x0F);
+            entry.soldierLength = static_cast<uint8_t>(words[soldier].size());
+            entry.resourceLength = static_cast<uint8_t>(words[resource].size());
+            memcpy(entry.soldier, words[soldier].data(), entry.soldierLength);
+            memcpy(entry.resource, words[resource].data(), entry.resourceLength);
+            if (!fn(entry)) return false;
+        }
+        return true;
+    }
+};
+
+// ------------------- ReportWriter -------------------
+// Formats text into a buffer and hands it to the sink only when the buffer fills or on
+// flush(), so reports cost no allocation per field and no flush per line.
+// Sinks: a FILE* (written with one fwrite per block), an ostream, or a string. File and
+// stream sinks borrow a BUFFER_SIZE buffer kept per thread for reuse, rather than
+// taking 64 KiB of stack; a string sink formats straight into the string.
+class ReportWriter {
+public:
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    explicit ReportWriter(FILE* f) : file(f) { borrowBuffer(); }
+    explicit ReportWriter(ostream& os) : stream(&os) { borrowBuffer(); }
+    explicit ReportWriter(string& s) : text(&s), start(s.size()) { buffer = text->data() + start; }
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+    ~ReportWriter() {
+        flush();
+        if (owned) spareBuffers().push_back(move(owned));
+    }
+
+    ReportWriter& operator<<(string_view value) {
+        if (text && capacity - used < value.size()) grow(value.size());
+        while (value.size() > capacity - used) {
+            size_t part = capacity - used;
+            memcpy(buffer + used, value.data(), part);
+            used += part;
+            value.remove_prefix(part);
+            flush();
+        }
+        memcpy(buffer + used, value.data(), value.size());
+        used += value.size();
+        return *this;
+    }
+
+    ReportWriter& operator<<(char c) {
+        if (used == capacity) makeRoom(1);
+        buffer[used++] = c;
+        return *this;
+    }
+
+    template <typename T, typename = enable_if_t<is_integral<T>::value && !is_same<T, char>::value>>
+    ReportWriter& operator<<(T value) {
+        if (capacity - used < 24) makeRoom(24);
+        used = static_cast<size_t>(to_chars(buffer + used, buffer + capacity, value).ptr - buffer);
+        return *this;
+    }
+
+    ReportWriter& operator<<(AccessLevel level) { return *this << static_cast<int>(level); }
+
+    // Hands the buffered bytes to the sink; returns false once any write has failed
+    bool flush() {
+        if (text) {
+            text->resize(start + used);  // drop the unused tail grow() reserved
+            start += used;
+            buffer = text->data() + start;
+            capacity = 0;
+        } else if (used && file) {
+            failed |= fwrite(buffer, 1, used, file) != used;
+        } else if (used) {
+            failed |= !stream->write(buffer, static_cast<streamsize>(used));
+        }
+        written += used;
+        used = 0;
+        return !failed;
+    }
+
+    bool ok() const { return !failed; }
+    uint64_t bytesWritten() const { return written + used; }
+
+    // Collects what fn writes into a string (for the toString() helpers)
+    template <typename Fn>
+    static string capture(Fn fn) {
+        string result;
+        {
+            ReportWriter out(result);
+            fn(out);
+        }
+        return result;
+    }
+
+private:
+    char* buffer = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    unique_ptr<char[]> owned;  // borrowed from spareBuffers()
+    uint64_t written = 0;
+    bool failed = false;
+    FILE* file = nullptr;
+    ostream* stream = nullptr;
+    string* text = nullptr;
+    size_t start = 0;          // where this writer's text begins in *text
+
+    static vector<unique_ptr<char[]>>& spareBuffers() {
+        thread_local vector<unique_ptr<char[]>> spares;
+        return spares;
+    }
+
+    void borrowBuffer() {
+        vector<unique_ptr<char[]>>& spares = spareBuffers();
+        if (spares.empty()) {
+            owned.reset(new char[BUFFER_SIZE]);
+        } else {
+            owned = move(spares.back());
+            spares.pop_back();
+        }
+        buffer = owned.get();
+        capacity = BUFFER_SIZE;
+    }
+
+    // Extends the string so that at least n more bytes fit, doubling as it goes
+    void grow(size_t n) {
+        text->resize(max(start + used + n, max<size_t>(2 * text->size(), 128)));
+        buffer = text->data() + start;
+        capacity = text->size() - start;
+    }
+
+    void makeRoom(size_t n) {
+        if (text) {
+            grow(n);
+        } else {
+            flush();
+        }
+    }
+};
 
 // ------------------- BaseEntity Class (Abstract) -------------------
 class BaseEntity {
@@ -34,15 +1000,22 @@ public:
         return rankLevel > other.rankLevel;
     }
 
+    string getName() const { return name; }
+    int getRankLevel() const { return rankLevel; }
     AccessLevel getAccessLevel() const { return accessLevel; }
     MilitaryBranch getBranch() const { return branch; }
 
     void displayInfo() const override {
-        cout << "Rank: " << name << " (Level: " << rankLevel << ", Access: " << static_cast<int>(accessLevel) << ")" << endl;
+        cout << "Rank: " << name << " (Level: " << rankLevel << ", Access: " << static_cast<int>(accessLevel) << ")" << "\n";
     }
 
+    static void write(ReportWriter& out, string_view name, int rankLevel, AccessLevel accessLevel) {
+        out << name << " (Level: " << rankLevel << ", Access: " << accessLevel << ")";
+    }
+    void write(ReportWriter& out) const { write(out, name, rankLevel, accessLevel); }
+
     string toString() const {
-        return name + " (Level: " + to_string(rankLevel) + ", Access: " + to_string(static_cast<int>(accessLevel)) + ")";
+        return ReportWriter::capture([&](ReportWriter& out) { write(out); });
     }
 };
 
@@ -57,15 +1030,28 @@ public:
            AccessLevel al = AccessLevel::CONFIDENTIAL)
         : name(n), type(t), damageRating(dmg), range(r), accuracy(acc), requiredAccess(al) {}
 
-    string getName() const { return name; }
+    const string& getName() const { return name; }
+    const string& getType() const { return type; }
+    int getDamageRating() const { return damageRating; }
+    int getRange() const { return range; }
+    int getAccuracy() const { return accuracy; }
     AccessLevel getRequiredAccess() const { return requiredAccess; }
 
+    friend bool operator==(const Weapon& w1, const Weapon& w2) {
+        return w1.name == w2.name && w1.type == w2.type && w1.damageRating == w2.damageRating &&
+               w1.range == w2.range && w1.accuracy == w2.accuracy && w1.requiredAccess == w2.requiredAccess;
+    }
+
     void displayInfo() const override {
-        cout << "Weapon: " << name << " (Type: " << type << ", Damage: " << damageRating << ", Range: " << range << " meters, Accuracy: " << accuracy << "%)" << endl;
+        cout << "Weapon: " << name << " (Type: " << type << ", Damage: " << damageRating << ", Range: " << range << " meters, Accuracy: " << accuracy << "%)" << "\n";
+    }
+
+    void write(ReportWriter& out) const {
+        out << name << " (Type: " << type << ", Damage: " << damageRating << ")";
     }
 
     string toString() const {
-        return name + " (Type: " + type + ", Damage: " + to_string(damageRating) + ")";
+        return ReportWriter::capture([&](ReportWriter& out) { write(out); });
     }
 
     // Overload the '+' operator to combine two weapons
@@ -80,460 +1066,5797 @@ public:
     }
 };
 
-// ------------------- Soldier -------------------
-class Soldier : public MilitaryRank {
+// ------------------- WeaponCatalog -------------------
+// Interned, immutable weapon definitions addressed by compact WeaponId handles.
+// Soldiers and the inventory store only ids; redefining a weapon name adds a new
+// entry, so weapons handed out earlier keep the stats they were issued with.
+typedef uint32_t WeaponId;
+
+class WeaponCatalog {
 private:
-    string id;
-    string firstName, lastName;
-    MilitaryRank rank;
-    string specialization;
-    int experienceYears;
-    bool active;
-    vector<string> skills;
-    vector<Weapon> assignedWeapons;
+    deque<Weapon> entries;                   // never modified once interned
+    unordered_map<string, WeaponId> byName;  // name -> latest definition
+public:
+    static constexpr WeaponId npos = UINT32_MAX;
+
+    WeaponId intern(const Weapon& weapon) {
+        auto it = byName.find(weapon.getName());
+        if (it != byName.end() && entries[it->second] == weapon) {
+            return it->second;
+        }
+        WeaponId id = static_cast<WeaponId>(entries.size());
+        entries.push_back(weapon);
+        byName[weapon.getName()] = id;
+        return id;
+    }
+
+    // Appends a definition under the next id without deduplicating (snapshot restore)
+    WeaponId append(const Weapon& weapon) {
+        WeaponId id = static_cast<WeaponId>(entries.size());
+        entries.push_back(weapon);
+        byName[weapon.getName()] = id;
+        return id;
+    }
+
+    WeaponId find(const string& name) const {
+        auto it = byName.find(name);
+        return (it != byName.end()) ? it->second : npos;
+    }
+
+    const Weapon& get(WeaponId id) const { return entries[id]; }
+    size_t size() const { return entries.size(); }
+
+    void clear() {
+        entries.clear();
+        byName.clear();
+    }
+};
+
+// ------------------- SmallVector -------------------
+// Vector of plain values that keeps the first N inline and only moves to the heap
+// beyond that. Skills and loadouts are short for almost every soldier, so they cost no
+// allocation and sit next to the rest of the record.
+template <typename T, size_t N>
+class SmallVector {
+    static_assert(is_trivially_copyable<T>::value, "SmallVector holds plain values only");
 
 public:
-    Soldier(string i, string fn, string ln, MilitaryRank r, string spec = "Infantry", int exp = 0)
-        : id(i), firstName(fn), lastName(ln), rank(r), specialization(spec), experienceYears(exp), active(true) {}
+    SmallVector() = default;
+    SmallVector(const SmallVector& other) { assign(other.begin(), other.end()); }
+    SmallVector(SmallVector&& other) noexcept { steal(other); }
+    ~SmallVector() { release(); }
 
-    void addSkill(const string& skill) { skills.push_back(skill); }
-    void assignWeapon(const Weapon& weapon) { assignedWeapons.push_back(weapon); }
-    void removeWeapon(const string& weaponName) {
-        assignedWeapons.erase(remove_if(assignedWeapons.begin(), assignedWeapons.end(),
-            [&](const Weapon& w) { return w.getName() == weaponName; }), assignedWeapons.end());
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) assign(other.begin(), other.end());
+        return *this;
+    }
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this != &other) {
+            release();
+            steal(other);
+        }
+        return *this;
     }
 
-    bool canAccess(const AccessLevel requiredAccess) const {
-        return static_cast<int>(rank.getAccessLevel()) >= static_cast<int>(requiredAccess);
+    void push_back(T value) {
+        if (count == cap) grow(2 * cap);
+        items[count++] = value;
     }
 
-    void displayInfo() const override {
-        cout << "Soldier: " << firstName << " " << lastName << ", Rank: " << rank.toString() << endl;
+    T* erase(T* first, T* last) {
+        memmove(first, last, (end() - last) * sizeof(T));
+        count -= static_cast<uint32_t>(last - first);
+        return first;
+    }
+
+    void reserve(size_t n) {
+        if (n > cap) grow(n);
+    }
+    void clear() { count = 0; }
+
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+    const T* data() const { return items; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T operator[](size_t i) const { return items[i]; }
+    bool isInline() const { return items == inlineItems; }
+
+private:
+    T* items = inlineItems;
+    uint32_t count = 0, cap = N;
+    T inlineItems[N];
+
+    void grow(size_t n) {
+        T* bigger = static_cast<T*>(::operator new(n * sizeof(T)));
+        memcpy(bigger, items, count * sizeof(T));
+        release();
+        items = bigger;
+        cap = static_cast<uint32_t>(n);
+    }
+
+    void release() {
+        if (!isInline()) ::operator delete(items);
+        items = inlineItems;
+        cap = N;
+    }
+
+    void steal(SmallVector& other) {
+        if (other.isInline()) {
+            memcpy(inlineItems, other.inlineItems, other.count * sizeof(T));
+        } else {
+            items = other.items;
+            cap = other.cap;
+            other.items = other.inlineItems;
+            other.cap = N;
+        }
+        count = other.count;
+        other.count = 0;
+    }
+
+    void assign(const T* first, const T* last) {
+        count = 0;
+        reserve(last - first);
+        memcpy(items, first, (last - first) * sizeof(T));
+        count = static_cast<uint32_t>(last - first);
+    }
+};
+
+typedef SmallVector<WeaponId, 4> Loadout;
+
+// ------------------- SkillNames -------------------
+// Process-wide skill name table. Soldiers store skills as SkillId; the name is only
+// looked up for output, snapshots and the journal, which keep the text. Interning is
+// locked because import workers build soldiers concurrently.
+typedef uint32_t SkillId;
+
+class SkillNames {
+public:
+    static SkillId intern(string_view name) {
+        SkillNames& table = instance();
+        lock_guard<mutex> guard(table.lock);
+        auto it = table.ids.find(name);
+        if (it != table.ids.end()) return it->second;
+        SkillId id = static_cast<SkillId>(table.names.size());
+        table.names.emplace_back(name);
+        table.ids.emplace(table.names.back(), id);  // keyed by a view of the stored copy
+        return id;
+    }
+
+    static const string& name(SkillId id) {
+        SkillNames& table = instance();
+        lock_guard<mutex> guard(table.lock);
+        return table.names[id];  // deque elements never move
+    }
+
+private:
+    mutex lock;
+    deque<string> names;
+    unordered_map<string_view, SkillId> ids;
+
+    static SkillNames& instance() {
+        static SkillNames table;
+        return table;
+    }
+};
+
+typedef SmallVector<SkillId, 6> SkillList;
+
+// Skill lists as text are separated by ';', as in import files and the journal
+SkillList parseSkillList(string_view text) {
+    SkillList skills;
+    while (!text.empty()) {
+        size_t end = text.find(';');
+        string_view skill = text.substr(0, end);
+        if (!skill.empty()) skills.push_back(SkillNames::intern(skill));
+        text = (end == string_view::npos) ? string_view() : text.substr(end + 1);
+    }
+    return skills;
+}
+
+string joinSkillList(const SkillList& skills) {
+    string text;
+    for (SkillId skill : skills) {
+        if (!text.empty()) text += ';';
+        text += SkillNames::name(skill);
+    }
+    return text;
+}
+
+// ------------------- Soldier -------------------
+class Soldier : public MilitaryRank {
+private:
+    string id;
+    string firstName, lastName;
+    MilitaryRank rank;
+    string specialization;
+    int experienceYears;
+    bool active;
+    SkillList skills;
+    Loadout assignedWeapons;
+
+public:
+    Soldier(string i, string fn, string ln, MilitaryRank r, string spec = "Infantry", int exp = 0)
+        : id(i), firstName(fn), lastName(ln), rank(r), specialization(spec), experienceYears(exp), active(true) {}
+
+    void addSkill(string_view skill) { skills.push_back(SkillNames::intern(skill)); }
+    void setRank(const MilitaryRank& newRank) { rank = newRank; }
+    void assignWeapon(WeaponId weapon) { assignedWeapons.push_back(weapon); }
+    void removeWeapon(WeaponId weapon) {
+        assignedWeapons.erase(remove(assignedWeapons.begin(), assignedWeapons.end(), weapon), assignedWeapons.end());
+    }
+
+    bool canAccess(const AccessLevel requiredAccess) const {
+        AccessLevel clearance = rank.getAccessLevel();
+        return AuditTrail::check(AuditKind::CLEARANCE, id, string_view(), clearance, requiredAccess,
+                                 static_cast<int>(clearance) >= static_cast<int>(requiredAccess));
+    }
+
+    void writeInfo(ReportWriter& out) const {
+        out << "Soldier: " << firstName << ' ' << lastName << ", Rank: ";
+        rank.write(out);
+        out << '\n';
+    }
+
+    void displayInfo() const override {
+        ReportWriter out(cout);
+        writeInfo(out);
+    }
+
+    void write(ReportWriter& out) const {
+        out << id << ": " << firstName << ' ' << lastName << " - ";
+        rank.write(out);
+    }
+
+    string toString() const {
+        return ReportWriter::capture([&](ReportWriter& out) { write(out); });
+    }
+
+    const string& getId() const { return id; }
+    string getFirstName() const { return firstName; }
+    string getLastName() const { return lastName; }
+    const string& getSpecialization() const { return specialization; }
+    int getExperienceYears() const { return experienceYears; }
+    const SkillList& getSkills() const { return skills; }
+    const MilitaryRank& getRank() const { return rank; }
+    AccessLevel getAccessLevel() const { return rank.getAccessLevel(); }
+    const Loadout& getWeapons() const { return assignedWeapons; }
+};
+
+// ------------------- Warzone -------------------
+class Warzone : public BaseEntity {
+private:
+    string id, name, location, description;
+    AccessLevel requiredAccessLevel;
+    uint32_t capacity = 0;   // soldiers deployed at most, 0 = unlimited
+    SkillList requiredSkills;
+    double latitude = NAN, longitude = NAN;  // degrees, NaN = not on the map
+public:
+    Warzone(string i, string n, string loc, string desc, AccessLevel al)
+        : id(i), name(n), location(loc), description(desc), requiredAccessLevel(al) {}
+
+    bool canAccess(const Soldier* soldier) const {
+        AccessLevel clearance = soldier->getAccessLevel();
+        return AuditTrail::check(AuditKind::WARZONE, soldier->getId(), id, clearance, requiredAccessLevel,
+                                 static_cast<int>(clearance) >= static_cast<int>(requiredAccessLevel));
+    }
+
+    // Deployment limits, see DeploymentScheduler
+    void setCapacity(uint32_t limit) { capacity = limit; }
+    void setRequiredSkills(const SkillList& skills) { requiredSkills = skills; }
+    uint32_t getCapacity() const { return capacity; }
+    const SkillList& getRequiredSkills() const { return requiredSkills; }
+
+    void setPosition(double lat, double lon) {
+        latitude = lat;
+        longitude = lon;
+    }
+    bool hasPosition() const { return !isnan(latitude); }
+    double getLatitude() const { return latitude; }
+    double getLongitude() const { return longitude; }
+
+    string getId() const { return id; }
+    string getName() const { return name; }
+    string getLocation() const { return location; }
+    string getDescription() const { return description; }
+    AccessLevel getRequiredAccess() const { return requiredAccessLevel; }
+
+    void displayInfo() const override {
+        cout << "Warzone: " << name << " located at " << location << ", Access Level: " << static_cast<int>(requiredAccessLevel) << "\n";
+    }
+
+    void write(ReportWriter& out) const { out << name << " at " << location; }
+
+    string toString() const {
+        return ReportWriter::capture([&](ReportWriter& out) { write(out); });
+    }
+};
+
+// ------------------- Inventory -------------------
+class Inventory : public BaseEntity {
+private:
+    // Stock is split across independently locked shards (weapons by id, supplies by
+    // hashed id), each on its own cache line, so depots issuing different items in
+    // parallel rarely touch the same lock.
+    static const size_t SHARD_COUNT = 16;
+
+    struct alignas(64) Shard {
+        mutable mutex lock;
+        uint64_t version = 0;  // bumped by every change, see InventoryTransaction
+        unordered_map<WeaponId, int> weapons;
+        unordered_map<string, pair<string, int>> supplies;
+    };
+
+    friend class InventoryTransaction;
+
+    const WeaponCatalog* catalog;   // resolves weapon ids for display
+    Shard shards[SHARD_COUNT];
+    AccessLevel requiredAccessLevel;
+    Journal* journal = nullptr;     // every mutation is logged here when attached
+
+    Shard& shardOf(WeaponId weapon) { return shards[weapon % SHARD_COUNT]; }
+    const Shard& shardOf(WeaponId weapon) const { return shards[weapon % SHARD_COUNT]; }
+    Shard& shardOf(const string& supplyId) { return shards[hash<string>()(supplyId) % SHARD_COUNT]; }
+    const Shard& shardOf(const string& supplyId) const { return shards[hash<string>()(supplyId) % SHARD_COUNT]; }
+
+public:
+    Inventory(const WeaponCatalog& c, AccessLevel al = AccessLevel::CONFIDENTIAL)
+        : catalog(&c), requiredAccessLevel(al) {}
+
+    void attachJournal(Journal* j) { journal = j; }
+
+    // Mutations are journaled while the shard is locked, so the log order of two
+    // changes to the same item always matches the order they were applied in.
+    // Quantities must be positive; anything else is rejected and changes nothing.
+    bool addWeapon(WeaponId weapon, int quantity) {
+        if (quantity <= 0) return false;
+        Shard& shard = shardOf(weapon);
+        lock_guard<mutex> guard(shard.lock);
+        if (journal) journal->append(JournalOp::ADD_WEAPON, weapon, quantity);
+        shard.weapons[weapon] += quantity;
+        ++shard.version;
+        return true;
+    }
+
+    void removeWeapon(WeaponId weapon, int quantity) {
+        if (quantity <= 0) return;
+        Shard& shard = shardOf(weapon);
+        lock_guard<mutex> guard(shard.lock);
+        if (journal) journal->append(JournalOp::REMOVE_WEAPON, weapon, quantity);
+        ++shard.version;
+        auto it = shard.weapons.find(weapon);
+        if (it != shard.weapons.end()) {
+            it->second -= quantity;
+            if (it->second <= 0) {
+                shard.weapons.erase(it);
+            }
+        }
+    }
+
+    // Takes 'quantity' only if that much is in stock; otherwise leaves stock untouched
+    bool tryRemoveWeapon(WeaponId weapon, int quantity) {
+        if (quantity <= 0) return false;
+        Shard& shard = shardOf(weapon);
+        lock_guard<mutex> guard(shard.lock);
+        auto it = shard.weapons.find(weapon);
+        if (it == shard.weapons.end() || it->second < quantity) return false;
+        if (journal) journal->append(JournalOp::REMOVE_WEAPON, weapon, quantity);
+        ++shard.version;
+        it->second -= quantity;
+        if (it->second <= 0) {
+            shard.weapons.erase(it);
+        }
+        return true;
+    }
+
+    bool addSupply(const string& supplyId, const string& description, int quantity) {
+        if (quantity <= 0) return false;
+        Shard& shard = shardOf(supplyId);
+        lock_guard<mutex> guard(shard.lock);
+        if (journal) journal->append(JournalOp::ADD_SUPPLY, supplyId, description, quantity);
+        ++shard.version;
+        auto it = shard.supplies.find(supplyId);
+        if (it != shard.supplies.end()) {
+            it->second.second += quantity;
+        } else {
+            shard.supplies.emplace(supplyId, make_pair(description, quantity));
+        }
+        return true;
+    }
+
+    void removeSupply(const string& supplyId, int quantity) {
+        if (quantity <= 0) return;
+        Shard& shard = shardOf(supplyId);
+        lock_guard<mutex> guard(shard.lock);
+        if (journal) journal->append(JournalOp::REMOVE_SUPPLY, supplyId, quantity);
+        ++shard.version;
+        auto it = shard.supplies.find(supplyId);
+        if (it != shard.supplies.end()) {
+            it->second.second -= quantity;
+            if (it->second.second <= 0) {
+                shard.supplies.erase(it);
+            }
+        }
+    }
+
+    bool tryRemoveSupply(const string& supplyId, int quantity) {
+        if (quantity <= 0) return false;
+        Shard& shard = shardOf(supplyId);
+        lock_guard<mutex> guard(shard.lock);
+        auto it = shard.supplies.find(supplyId);
+        if (it == shard.supplies.end() || it->second.second < quantity) return false;
+        if (journal) journal->append(JournalOp::REMOVE_SUPPLY, supplyId, quantity);
+        ++shard.version;
+        it->second.second -= quantity;
+        if (it->second.second <= 0) {
+            shard.supplies.erase(it);
+        }
+        return true;
+    }
+
+    int getWeaponQuantity(WeaponId weapon) const {
+        const Shard& shard = shardOf(weapon);
+        lock_guard<mutex> guard(shard.lock);
+        auto it = shard.weapons.find(weapon);
+        return (it != shard.weapons.end()) ? it->second : 0;
+    }
+
+    int getSupplyQuantity(const string& supplyId) const {
+        const Shard& shard = shardOf(supplyId);
+        lock_guard<mutex> guard(shard.lock);
+        auto it = shard.supplies.find(supplyId);
+        return (it != shard.supplies.end()) ? it->second.second : 0;
+    }
+
+    bool canAccess(const Soldier* soldier) const {
+        AccessLevel clearance = soldier->getAccessLevel();
+        return AuditTrail::check(AuditKind::INVENTORY, soldier->getId(), string_view(), clearance, requiredAccessLevel,
+                                 static_cast<int>(clearance) >= static_cast<int>(requiredAccessLevel));
+    }
+
+    AccessLevel getRequiredAccess() const { return requiredAccessLevel; }
+
+    // Visits a consistent-per-shard copy of the stock in id order
+    template <typename Fn>
+    void forEachWeapon(Fn fn) const {
+        vector<pair<WeaponId, int>> stock;
+        for (const Shard& shard : shards) {
+            lock_guard<mutex> guard(shard.lock);
+            stock.insert(stock.end(), shard.weapons.begin(), shard.weapons.end());
+        }
+        sort(stock.begin(), stock.end());
+        for (const auto& [id, quantity] : stock) fn(id, quantity);
+    }
+
+    template <typename Fn>
+    void forEachSupply(Fn fn) const {
+        vector<pair<string, pair<string, int>>> stock;
+        for (const Shard& shard : shards) {
+            lock_guard<mutex> guard(shard.lock);
+            stock.insert(stock.end(), shard.supplies.begin(), shard.supplies.end());
+        }
+        sort(stock.begin(), stock.end());
+        for (const auto& [id, pair] : stock) fn(id, pair.first, pair.second);
+    }
+
+    void clear() {
+        for (Shard& shard : shards) {
+            lock_guard<mutex> guard(shard.lock);
+            shard.weapons.clear();
+            shard.supplies.clear();
+            ++shard.version;
+        }
+    }
+
+    // Writes the weapon and supply lists, sorted, from one consistent view of all shards.
+    // The rows are copied with every shard locked (in index order, as transactions do),
+    // then the locks are released before sorting and writing, so a slow sink never
+    // holds up issuing. The copies go into reused per-thread buffers.
+    void writeStock(ReportWriter& out) const {
+        struct SupplyRow {
+            string id, description;
+            int quantity;
+        };
+        thread_local vector<pair<WeaponId, int>> weaponRows;
+        thread_local vector<SupplyRow> supplyRows;  // only the first supplyCount are in use
+        thread_local vector<const SupplyRow*> supplyOrder;
+        size_t supplyCount = 0;
+        weaponRows.clear();
+        supplyOrder.clear();
+        {
+            unique_lock<mutex> locks[SHARD_COUNT];
+            for (size_t i = 0; i < SHARD_COUNT; ++i) {
+                locks[i] = unique_lock<mutex>(shards[i].lock);
+                weaponRows.insert(weaponRows.end(), shards[i].weapons.begin(), shards[i].weapons.end());
+                for (const auto& [id, supply] : shards[i].supplies) {
+                    if (supplyCount == supplyRows.size()) supplyRows.emplace_back();
+                    SupplyRow& row = supplyRows[supplyCount++];
+                    row.id = id;  // assignment reuses the strings' capacity
+                    row.description = supply.first;
+                    row.quantity = supply.second;
+                }
+            }
+        }
+        sort(weaponRows.begin(), weaponRows.end());
+        for (size_t i = 0; i < supplyCount; ++i) supplyOrder.push_back(&supplyRows[i]);
+        sort(supplyOrder.begin(), supplyOrder.end(), [](const SupplyRow* a, const SupplyRow* b) { return a->id < b->id; });
+
+        out << "Weapons:\n";
+        for (const auto& [id, quantity] : weaponRows) out << "- " << catalog->get(id).getName() << " x" << quantity << '\n';
+        out << "Supplies:\n";
+        for (const SupplyRow* row : supplyOrder) {
+            out << "- " << row->id << ": " << row->description << " x" << row->quantity << '\n';
+        }
+    }
+
+    void writeInfo(ReportWriter& out) const {
+        out << "Inventory Access Level: " << requiredAccessLevel << '\n';
+        writeStock(out);
+    }
+
+    void displayInfo() const override {
+        ReportWriter out(cout);
+        writeInfo(out);
+    }
+
+    string toString() const {
+        return ReportWriter::capture([&](ReportWriter& out) {
+            out << "Inventory:\n";
+            writeStock(out);
+        });
+    }
+};
+
+// ------------------- MappedFile -------------------
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping) return false;
+        bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!bytes) {
+            CloseHandle(mapping);
+            mapping = nullptr;
+            return false;
+        }
+        length = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) return false;
+        bytes = static_cast<const char*>(addr);
+        length = static_cast<size_t>(st.st_size);
+#endif
+        return true;
+    }
+
+    void close() {
+        if (!bytes) return;
+#ifdef _WIN32
+        UnmapViewOfFile(bytes);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(const_cast<char*>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+// ------------------- Snapshot format -------------------
+// Versioned binary image of the whole system. A fixed header is followed by 8-byte
+// aligned sections of flat, trivially copyable records; strings live in one shared
+// section and are referenced by (offset, length). Soldier columns are stored exactly
+// as SoldierStore keeps them, and a soldier-ID index sorted by ID lets a mapped image
+// answer lookups without being parsed first.
+const char SNAPSHOT_MAGIC[8] = { 'M', 'I', 'L', 'S', 'N', 'A', 'P', '\0' };
+const uint32_t SNAPSHOT_VERSION = 5;  // 2: journal epoch in the header, 3: unit sections, 4: deployments, 5: positions
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+enum SnapshotSectionId {
+    SECTION_STRINGS,        // char
+    SECTION_RANK_LEVELS,    // int32_t per soldier
+    SECTION_ACCESS_LEVELS,  // AccessLevel per soldier
+    SECTION_BRANCHES,       // MilitaryBranch per soldier
+    SECTION_SOLDIERS,       // SnapshotSoldier per soldier
+    SECTION_SKILLS,         // SnapshotString
+    SECTION_LOADOUTS,       // WeaponId
+    SECTION_ID_INDEX,       // SoldierHandle, sorted by soldier ID
+    SECTION_WEAPONS,        // SnapshotWeapon per WeaponId
+    SECTION_WARZONES,       // SnapshotWarzone per warzone slot
+    SECTION_WEAPON_STOCK,   // SnapshotStock
+    SECTION_SUPPLIES,       // SnapshotSupply
+    SECTION_UNITS,          // uint32_t unit id per soldier (0 = none)
+    SECTION_UNIT_NAMES,     // SnapshotString per unit id, starting at 1
+    SECTION_WARZONE_LIMITS, // SnapshotWarzoneLimits per warzone slot
+    SECTION_WARZONE_SKILLS, // SnapshotString
+    SECTION_DEPLOYMENTS,    // uint32_t per soldier: 0 = not in the pool, 1 = waiting, 2 + warzone slot
+    SECTION_WARZONE_POSITIONS, // SnapshotWarzonePosition per warzone slot
+    SECTION_COUNT
+};
+
+// Sections present in a file of the given version; each version only appends sections
+int snapshotSectionCount(uint32_t version) {
+    switch (version) {
+    case 2: return SECTION_UNITS;
+    case 3: return SECTION_WARZONE_LIMITS;
+    case 4: return SECTION_WARZONE_POSITIONS;
+    default: return SECTION_COUNT;
+    }
+}
+
+struct SnapshotSection {
+    uint64_t offset, count, bytes;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t fileSize;
+    uint64_t journalEpoch;  // only a journal of the same epoch is replayed on top
+    SnapshotSection sections[SECTION_COUNT];
+};
+
+struct SnapshotString {
+    uint32_t offset, length;
+};
+
+struct SnapshotSoldier {
+    SnapshotString id, firstName, lastName, rankName, specialization;
+    int32_t experienceYears;
+    uint32_t skillsBegin, skillCount;
+    uint32_t weaponsBegin, weaponCount;
+};
+
+struct SnapshotWeapon {
+    SnapshotString name, type;
+    int32_t damageRating, range, accuracy;
+    uint32_t requiredAccess;
+};
+
+struct SnapshotWarzone {
+    SnapshotString id, name, location, description;
+    uint32_t requiredAccess;
+};
+
+struct SnapshotWarzoneLimits {
+    uint32_t capacity;
+    uint32_t skillsBegin, skillCount;  // range in SECTION_WARZONE_SKILLS
+};
+
+struct SnapshotWarzonePosition {
+    double latitude, longitude;  // NaN = not on the map
+};
+
+struct SnapshotStock {
+    uint32_t weapon;
+    int32_t quantity;
+};
+
+struct SnapshotSupply {
+    SnapshotString id, description;
+    int32_t quantity;
+};
+
+static_assert(is_trivially_copyable<SnapshotSoldier>::value && is_trivially_copyable<SnapshotWeapon>::value &&
+              is_trivially_copyable<SnapshotWarzone>::value && is_trivially_copyable<SnapshotSupply>::value,
+              "snapshot records are written and mapped as raw bytes");
+
+// Element size of each section, used to validate a mapped image
+const size_t SNAPSHOT_ELEMENT_SIZE[SECTION_COUNT] = {
+    sizeof(char), sizeof(int32_t), sizeof(AccessLevel), sizeof(MilitaryBranch), sizeof(SnapshotSoldier),
+    sizeof(SnapshotString), sizeof(uint32_t), sizeof(uint32_t), sizeof(SnapshotWeapon),
+    sizeof(SnapshotWarzone), sizeof(SnapshotStock), sizeof(SnapshotSupply), sizeof(uint32_t), sizeof(SnapshotString),
+    sizeof(SnapshotWarzoneLimits), sizeof(SnapshotString), sizeof(uint32_t), sizeof(SnapshotWarzonePosition)
+};
+
+// A validated, mapped snapshot. Records are read in place.
+class SnapshotImage {
+private:
+    MappedFile file;
+    const SnapshotHeader* header = nullptr;
+    int sectionCount = 0;  // sections present in this file's version
+
+public:
+    // Maps the file and checks the header and section bounds; records are not touched
+    bool open(const string& path, string& error) {
+        if (!file.open(path)) {
+            error = "cannot open or map file";
+            return false;
+        }
+        if (file.size() < offsetof(SnapshotHeader, sections)) {
+            error = "file too small";
+            return false;
+        }
+        header = reinterpret_cast<const SnapshotHeader*>(file.data());
+        if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+            error = "not a snapshot file";
+            return false;
+        }
+        if (header->version < 2 || header->version > SNAPSHOT_VERSION || header->byteOrder != SNAPSHOT_BYTE_ORDER) {
+            error = "unsupported snapshot version";
+            return false;
+        }
+        sectionCount = snapshotSectionCount(header->version);
+        if (header->fileSize != file.size() ||
+            file.size() < offsetof(SnapshotHeader, sections) + sectionCount * sizeof(SnapshotSection)) {
+            error = "truncated snapshot";
+            return false;
+        }
+        for (int i = 0; i < sectionCount; ++i) {
+            const SnapshotSection& sec = header->sections[i];
+            if (sec.offset % 8 != 0 || sec.offset > file.size() || sec.bytes > file.size() - sec.offset ||
+                sec.bytes != sec.count * SNAPSHOT_ELEMENT_SIZE[i]) {
+                error = "corrupt section table";
+                return false;
+            }
+        }
+        uint64_t soldiers = count(SECTION_SOLDIERS);
+        if (count(SECTION_RANK_LEVELS) != soldiers || count(SECTION_ACCESS_LEVELS) != soldiers ||
+            count(SECTION_BRANCHES) != soldiers || count(SECTION_ID_INDEX) != soldiers ||
+            (count(SECTION_UNITS) != soldiers && count(SECTION_UNITS) != 0) ||
+            (count(SECTION_DEPLOYMENTS) != soldiers && count(SECTION_DEPLOYMENTS) != 0) ||
+            (count(SECTION_WARZONE_LIMITS) != count(SECTION_WARZONES) && count(SECTION_WARZONE_LIMITS) != 0) ||
+            (count(SECTION_WARZONE_POSITIONS) != count(SECTION_WARZONES) && count(SECTION_WARZONE_POSITIONS) != 0)) {
+            error = "soldier sections disagree";
+            return false;
+        }
+        // Access levels and branches index per-level and per-branch tables once loaded,
+        // so they get the same range checks as journal replay
+        const uint8_t* access = section<uint8_t>(SECTION_ACCESS_LEVELS);
+        const uint8_t* branches = section<uint8_t>(SECTION_BRANCHES);
+        for (uint64_t i = 0; i < soldiers; ++i) {
+            if (!isValidAccessLevel(access[i]) || !isValidBranch(branches[i])) {
+                error = "soldier access level or branch out of range";
+                return false;
+            }
+        }
+        const SnapshotWeapon* weapons = section<SnapshotWeapon>(SECTION_WEAPONS);
+        for (uint64_t i = 0; i < count(SECTION_WEAPONS); ++i) {
+            if (!isValidAccessLevel(static_cast<int>(weapons[i].requiredAccess))) {
+                error = "weapon access level out of range";
+                return false;
+            }
+        }
+        const SnapshotWarzone* zones = section<SnapshotWarzone>(SECTION_WARZONES);
+        for (uint64_t i = 0; i < count(SECTION_WARZONES); ++i) {
+            if (!isValidAccessLevel(static_cast<int>(zones[i].requiredAccess))) {
+                error = "warzone access level out of range";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Sections newer than the file's version read as empty
+    uint64_t count(SnapshotSectionId id) const { return id < sectionCount ? header->sections[id].count : 0; }
+    uint64_t journalEpoch() const { return header->journalEpoch; }
+
+    template <typename T>
+    const T* section(SnapshotSectionId id) const {
+        return reinterpret_cast<const T*>(file.data() + header->sections[id].offset);
+    }
+
+    // Bounds-checked view of a string in the string section
+    string_view str(SnapshotString s) const {
+        uint64_t total = count(SECTION_STRINGS);
+        if (s.offset > total || s.length > total - s.offset) return string_view();
+        return string_view(section<char>(SECTION_STRINGS) + s.offset, s.length);
+    }
+};
+
+// Streams a snapshot to a temporary file and moves it into place once it is complete
+class SnapshotWriter {
+private:
+    FILE* file = nullptr;
+    string tmpPath;
+    SnapshotHeader header;
+    uint64_t offset = 0;
+    string strings;
+    unordered_map<string, SnapshotString> internedStrings;
+    bool ok = true;
+
+    void write(const void* data, size_t bytes) {
+        if (bytes && fwrite(data, 1, bytes, file) != bytes) ok = false;
+        offset += bytes;
+    }
+
+    void align() {
+        static const char zeros[8] = {};
+        write(zeros, (8 - offset % 8) % 8);
+    }
+
+public:
+    SnapshotWriter() { memset(&header, 0, sizeof(header)); }
+    ~SnapshotWriter() {
+        if (file) {
+            fclose(file);
+            remove(tmpPath.c_str());
+        }
+    }
+
+    bool open(const string& path) {
+        tmpPath = path + ".tmp";
+        file = fopen(tmpPath.c_str(), "wb");
+        if (!file) return false;
+        write(&header, sizeof(header));  // placeholder, rewritten by finish()
+        return ok;
+    }
+
+    // Adds a string to the string section. Repeated values (rank names, weapon types,
+    // skills) can be interned so they are stored once.
+    SnapshotString addString(const string& value, bool intern = false) {
+        if (intern) {
+            auto it = internedStrings.find(value);
+            if (it != internedStrings.end()) return it->second;
+        }
+        if (strings.size() + value.size() > UINT32_MAX) ok = false;
+        SnapshotString ref = { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(value.size()) };
+        strings += value;
+        if (intern) internedStrings.emplace(value, ref);
+        return ref;
+    }
+
+    template <typename T>
+    void writeSection(SnapshotSectionId id, const T* data, size_t count) {
+        align();
+        header.sections[id] = { offset, count, count * sizeof(T) };
+        write(data, count * sizeof(T));
+    }
+
+    bool finish(const string& path, uint64_t journalEpoch) {
+        writeSection(SECTION_STRINGS, strings.data(), strings.size());
+        align();
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header.version = SNAPSHOT_VERSION;
+        header.byteOrder = SNAPSHOT_BYTE_ORDER;
+        header.fileSize = offset;
+        header.journalEpoch = journalEpoch;
+        if (fseek(file, 0, SEEK_SET) != 0) ok = false;
+        if (fwrite(&header, sizeof(header), 1, file) != 1) ok = false;
+        if (!syncFile(file)) ok = false;
+        if (fclose(file) != 0) ok = false;
+        file = nullptr;
+        if (ok) ok = replaceFile(tmpPath, path);
+        if (!ok) remove(tmpPath.c_str());
+        return ok;
+    }
+};
+
+// ------------------- ObjectPool -------------------
+// Fixed-size slots carved out of large chunks, with a free list for reuse. Objects stay
+// at the same address until destroyed, neighbours are allocated next to each other, and
+// clear() (or the destructor) tears everything down chunk by chunk instead of one
+// delete per object.
+template <typename T, size_t CHUNK_SIZE = 1024>
+class ObjectPool {
+private:
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];  // first member: a T* is a Slot*
+        Slot* nextFree;
+        bool live;
+    };
+
+    vector<unique_ptr<Slot[]>> chunks;
+    size_t usedInLastChunk = CHUNK_SIZE;
+    Slot* freeList = nullptr;
+    size_t liveCount = 0;
+
+    Slot* allocateSlot() {
+        if (freeList) {
+            Slot* slot = freeList;
+            freeList = slot->nextFree;
+            return slot;
+        }
+        if (usedInLastChunk == CHUNK_SIZE) {
+            chunks.emplace_back(new Slot[CHUNK_SIZE]);
+            usedInLastChunk = 0;
+        }
+        return &chunks.back()[usedInLastChunk++];
+    }
+
+    void releaseSlot(Slot* slot) {
+        slot->live = false;
+        slot->nextFree = freeList;
+        freeList = slot;
+    }
+
+public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    ~ObjectPool() { clear(); }
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        Slot* slot = allocateSlot();
+        T* object;
+        try {
+            object = new (slot->storage) T(forward<Args>(args)...);
+        } catch (...) {
+            releaseSlot(slot);
+            throw;
+        }
+        slot->live = true;
+        ++liveCount;
+        return object;
+    }
+
+    void destroy(T* object) {
+        if (!object) return;
+        object->~T();
+        releaseSlot(reinterpret_cast<Slot*>(object));
+        --liveCount;
+    }
+
+    // Destroys every live object and returns all chunks at once
+    void clear() {
+        if (!is_trivially_destructible<T>::value) {
+            for (size_t c = 0; c < chunks.size(); ++c) {
+                size_t used = (c + 1 == chunks.size()) ? usedInLastChunk : CHUNK_SIZE;
+                for (size_t i = 0; i < used; ++i) {
+                    if (chunks[c][i].live) reinterpret_cast<T*>(chunks[c][i].storage)->~T();
+                }
+            }
+        }
+        chunks.clear();
+        usedInLastChunk = CHUNK_SIZE;
+        freeList = nullptr;
+        liveCount = 0;
+    }
+
+    size_t size() const { return liveCount; }
+};
+
+// ------------------- Bitmap -------------------
+class Bitmap {
+private:
+    vector<uint64_t> words;
+public:
+    void set(size_t bit) {
+        if (bit / 64 >= words.size()) words.resize(bit / 64 + 1, 0);
+        words[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    void reset(size_t bit) {
+        if (bit / 64 < words.size()) words[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+    }
+    bool test(size_t bit) const {
+        return bit / 64 < words.size() && (words[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    // Sets bits [0, n) and clears everything else
+    void fill(size_t n) {
+        words.assign((n + 63) / 64, ~uint64_t(0));
+        if (n % 64) words.back() = (uint64_t(1) << (n % 64)) - 1;
+    }
+    void clear() { words.clear(); }
+
+    void orWith(const Bitmap& other) {
+        if (other.words.size() > words.size()) words.resize(other.words.size(), 0);
+        for (size_t w = 0; w < other.words.size(); ++w) words[w] |= other.words[w];
+    }
+    void andWith(const Bitmap& other) {
+        if (words.size() > other.words.size()) words.resize(other.words.size());
+        for (size_t w = 0; w < words.size(); ++w) words[w] &= other.words[w];
+    }
+
+    size_t count() const {
+        size_t n = 0;
+        for (uint64_t word : words) n += static_cast<size_t>(__builtin_popcountll(word));
+        return n;
+    }
+
+    // Calls fn(bit) for every set bit, in increasing order
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (size_t w = 0; w < words.size(); ++w) {
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                fn(w * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+            }
+        }
+    }
+};
+
+// ------------------- SoldierIndex -------------------
+typedef uint32_t SoldierHandle;
+
+// Conditions of a find_soldiers query; a field left at its default matches everyone
+struct SoldierQuery {
+    uint32_t branches = 0;  // bit per MilitaryBranch value, 0 = any
+    int minAccess = static_cast<int>(AccessLevel::CONFIDENTIAL), maxAccess = static_cast<int>(AccessLevel::SCI);
+    int minRank = INT_MIN, maxRank = INT_MAX;
+    int minExperience = INT_MIN, maxExperience = INT_MAX;
+    string specialization;  // empty = any
+};
+
+// Bitmaps for an integer field: one per value in [lo, hi], plus one for values below
+// and one for values above. The two overflow bitmaps hold mixed values, so a range
+// lookup that uses them must be re-checked against the exact value.
+class RangeBitmapIndex {
+private:
+    int lo, hi;
+    vector<Bitmap> buckets;  // [0] below lo, [1 + v - lo] value v, [back] above hi
+
+    size_t bucketOf(int value) const {
+        if (value < lo) return 0;
+        if (value > hi) return buckets.size() - 1;
+        return static_cast<size_t>(value - lo) + 1;
+    }
+
+public:
+    RangeBitmapIndex(int l, int h) : lo(l), hi(h), buckets(static_cast<size_t>(h - l) + 3) {}
+
+    void insert(size_t bit, int value) { buckets[bucketOf(value)].set(bit); }
+    void erase(size_t bit, int value) { buckets[bucketOf(value)].reset(bit); }
+    void clear() { for (Bitmap& b : buckets) b.clear(); }
+
+    // ORs every bit whose value may lie in [from, to] into result. Returns true if an
+    // overflow bucket was used, i.e. the result must be re-checked exactly.
+    bool collect(int from, int to, Bitmap& result) const {
+        if (from > to) return false;
+        size_t first = bucketOf(from), last = bucketOf(to);
+        for (size_t b = first; b <= last; ++b) result.orWith(buckets[b]);
+        return first == 0 || last == buckets.size() - 1;
+    }
+};
+
+// Secondary indexes over the roster, by handle: one bitmap per branch and access level,
+// range bitmaps for rank level and experience, and a sorted handle list per
+// specialization. A query ORs the bitmaps of the values each condition accepts, ANDs
+// the conditions 64 soldiers per word, then walks the specialization list if one is
+// given, so its cost follows the index sizes rather than a per-soldier scan.
+class SoldierIndex {
+public:
+    // The indexed fields of one soldier
+    struct Fields {
+        MilitaryBranch branch;
+        AccessLevel access;
+        int rankLevel;
+        int experience;
+        string_view specialization;
+    };
+
+    void insert(SoldierHandle h, const Fields& f) {
+        if (isValidBranch(static_cast<int>(f.branch))) byBranch[static_cast<int>(f.branch)].set(h);
+        if (isValidAccessLevel(static_cast<int>(f.access))) byAccess[static_cast<int>(f.access) - 1].set(h);
+        byRank.insert(h, f.rankLevel);
+        byExperience.insert(h, f.experience);
+        if (h >= rankLevels.size()) {
+            rankLevels.resize(h + 1);
+            experience.resize(h + 1);
+        }
+        rankLevels[h] = f.rankLevel;
+        experience[h] = f.experience;
+        vector<SoldierHandle>& list = bySpecialization[string(f.specialization)];
+        list.insert(upper_bound(list.begin(), list.end(), h), h);
+    }
+
+    void erase(SoldierHandle h, const Fields& f) {
+        if (isValidBranch(static_cast<int>(f.branch))) byBranch[static_cast<int>(f.branch)].reset(h);
+        if (isValidAccessLevel(static_cast<int>(f.access))) byAccess[static_cast<int>(f.access) - 1].reset(h);
+        byRank.erase(h, f.rankLevel);
+        byExperience.erase(h, f.experience);
+        auto it = bySpecialization.find(string(f.specialization));
+        if (it == bySpecialization.end()) return;
+        auto pos = lower_bound(it->second.begin(), it->second.end(), h);
+        if (pos != it->second.end() && *pos == h) it->second.erase(pos);
+        if (it->second.empty()) bySpecialization.erase(it);
+    }
+
+    void clear() {
+        for (Bitmap& b : byBranch) b.clear();
+        for (Bitmap& b : byAccess) b.clear();
+        byRank.clear();
+        byExperience.clear();
+        bySpecialization.clear();
+        rankLevels.clear();
+        experience.clear();
+    }
+
+    // Handles matching every condition, in increasing order, out of [0, count)
+    vector<SoldierHandle> query(const SoldierQuery& q, size_t count) const {
+        vector<SoldierHandle> matches;
+        const vector<SoldierHandle>* specialists = nullptr;
+        if (!q.specialization.empty()) {
+            auto it = bySpecialization.find(q.specialization);
+            if (it == bySpecialization.end()) return matches;
+            specialists = &it->second;
+        }
+
+        Bitmap result, any;
+        result.fill(count);
+        if (q.branches) {
+            for (int b = 0; b < BRANCH_COUNT; ++b) {
+                if (q.branches & (1u << b)) any.orWith(byBranch[b]);
+            }
+            result.andWith(any);
+        }
+        if (q.minAccess > static_cast<int>(AccessLevel::CONFIDENTIAL) || q.maxAccess < static_cast<int>(AccessLevel::SCI)) {
+            any.clear();
+            for (int l = max(q.minAccess, 1); l <= min(q.maxAccess, ACCESS_LEVEL_COUNT); ++l) any.orWith(byAccess[l - 1]);
+            result.andWith(any);
+        }
+        bool recheckRank = false, recheckExperience = false;
+        if (q.minRank != INT_MIN || q.maxRank != INT_MAX) {
+            any.clear();
+            recheckRank = byRank.collect(q.minRank, q.maxRank, any);
+            result.andWith(any);
+        }
+        if (q.minExperience != INT_MIN || q.maxExperience != INT_MAX) {
+            any.clear();
+            recheckExperience = byExperience.collect(q.minExperience, q.maxExperience, any);
+            result.andWith(any);
+        }
+
+        auto accept = [&](size_t h) {
+            if (recheckRank && (rankLevels[h] < q.minRank || rankLevels[h] > q.maxRank)) return;
+            if (recheckExperience && (experience[h] < q.minExperience || experience[h] > q.maxExperience)) return;
+            matches.push_back(static_cast<SoldierHandle>(h));
+        };
+        if (specialists) {
+            for (SoldierHandle h : *specialists) {
+                if (result.test(h)) accept(h);
+            }
+        } else {
+            result.forEach(accept);
+        }
+        return matches;
+    }
+
+private:
+    Bitmap byBranch[BRANCH_COUNT];
+    Bitmap byAccess[ACCESS_LEVEL_COUNT];
+    RangeBitmapIndex byRank{MIN_RANK_LEVEL, MAX_RANK_LEVEL};
+    RangeBitmapIndex byExperience{0, 50};
+    unordered_map<string, vector<SoldierHandle>> bySpecialization;
+    vector<int32_t> rankLevels, experience;  // exact values for re-checks of the overflow buckets
+};
+
+// ------------------- SeniorityIndex -------------------
+// Order-statistic trees of soldiers in seniority order: higher rank level first, then
+// more years of experience, then lower handle. Each tree is a treap whose nodes carry
+// their subtree size, so top-k, "nth most senior" and "how many are senior to X" take
+// O(log n) (plus k to list the top k). There is one tree for the whole force, one per
+// branch and one per unit; nodes are addressed by index in one shared vector.
+class SeniorityIndex {
+public:
+    struct Key {
+        int32_t rankLevel, experience;
+        SoldierHandle handle;
+    };
+
+    static constexpr uint32_t FORCE = 0;
+    static uint32_t branchGroup(MilitaryBranch branch) { return 1 + static_cast<uint32_t>(branch); }
+    static uint32_t unitGroup(uint32_t unit) { return BRANCH_COUNT + unit; }  // units are numbered from 1
+
+    void insert(uint32_t group, const Key& key) {
+        if (group >= roots.size()) roots.resize(group + 1, NIL);
+        uint32_t node = allocate(key, static_cast<uint32_t>(rng()));
+        uint32_t left, right;
+        split(roots[group], key, left, right);
+        roots[group] = merge(merge(left, node), right);
+    }
+
+    void erase(uint32_t group, const Key& key) {
+        if (group >= roots.size()) return;
+        uint32_t left, rest, node, right;
+        split(roots[group], key, left, rest);
+        Key next = key;
+        ++next.handle;  // the key just after this one
+        split(rest, next, node, right);
+        if (node != NIL) freeNodes.push_back(node);
+        roots[group] = merge(left, right);
+    }
+
+    // Replaces a group's contents with keys (sorted here) in O(n log n) without
+    // rotations: the tree is built balanced, then handed sorted random priorities in
+    // breadth-first order so it still satisfies the treap heap order.
+    void build(uint32_t group, vector<Key>& keys) {
+        if (group >= roots.size()) roots.resize(group + 1, NIL);
+        sort(keys.begin(), keys.end(), before);
+        uint32_t root = buildRange(keys, 0, keys.size());
+        roots[group] = root;
+        if (root == NIL) return;
+
+        vector<uint32_t> priorities(keys.size());
+        for (uint32_t& p : priorities) p = static_cast<uint32_t>(rng());
+        sort(priorities.begin(), priorities.end(), greater<uint32_t>());
+        vector<uint32_t> queue{ root };
+        queue.reserve(keys.size());
+        for (size_t i = 0; i < queue.size(); ++i) {
+            Node& node = nodes[queue[i]];
+            node.priority = priorities[i];
+            if (node.left != NIL) queue.push_back(node.left);
+            if (node.right != NIL) queue.push_back(node.right);
+        }
+    }
+
+    void clear() {
+        nodes.clear();
+        freeNodes.clear();
+        roots.clear();
+    }
+
+    size_t size(uint32_t group) const { return group < roots.size() ? sizeOf(roots[group]) : 0; }
+
+    // Number of soldiers in the group more senior than key
+    size_t countBefore(uint32_t group, const Key& key) const {
+        size_t count = 0;
+        for (uint32_t t = group < roots.size() ? roots[group] : NIL; t != NIL;) {
+            if (before(nodes[t].key, key)) {
+                count += sizeOf(nodes[t].left) + 1;
+                t = nodes[t].right;
+            } else {
+                t = nodes[t].left;
+            }
+        }
+        return count;
+    }
+
+    // The n-th most senior soldier (0-based); npos if n is out of range
+    SoldierHandle nth(uint32_t group, size_t n) const {
+        uint32_t t = group < roots.size() ? roots[group] : NIL;
+        while (t != NIL) {
+            size_t leftSize = sizeOf(nodes[t].left);
+            if (n < leftSize) {
+                t = nodes[t].left;
+            } else if (n == leftSize) {
+                return nodes[t].key.handle;
+            } else {
+                n -= leftSize + 1;
+                t = nodes[t].right;
+            }
+        }
+        return UINT32_MAX;
+    }
+
+    // Calls fn(handle) for the k most senior soldiers, most senior first
+    template <typename Fn>
+    void forEachTop(uint32_t group, size_t k, Fn fn) const {
+        if (group < roots.size()) visitInOrder(roots[group], k, fn);
+    }
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        Key key;
+        uint32_t left, right, priority, size;
+    };
+
+    vector<Node> nodes;
+    vector<uint32_t> freeNodes;
+    vector<uint32_t> roots;  // per group
+    mt19937 rng{0x5EED};
+
+    static bool before(const Key& a, const Key& b) {
+        if (a.rankLevel != b.rankLevel) return a.rankLevel > b.rankLevel;
+        if (a.experience != b.experience) return a.experience > b.experience;
+        return a.handle < b.handle;
+    }
+
+    size_t sizeOf(uint32_t t) const { return t == NIL ? 0 : nodes[t].size; }
+    void update(uint32_t t) { nodes[t].size = static_cast<uint32_t>(1 + sizeOf(nodes[t].left) + sizeOf(nodes[t].right)); }
+
+    uint32_t allocate(const Key& key, uint32_t priority) {
+        uint32_t t;
+        if (!freeNodes.empty()) {
+            t = freeNodes.back();
+            freeNodes.pop_back();
+        } else {
+            t = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[t] = { key, NIL, NIL, priority, 1 };
+        return t;
+    }
+
+    uint32_t buildRange(const vector<Key>& keys, size_t lo, size_t hi) {
+        if (lo >= hi) return NIL;
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t t = allocate(keys[mid], 0);
+        uint32_t left = buildRange(keys, lo, mid);
+        uint32_t right = buildRange(keys, mid + 1, hi);
+        nodes[t].left = left;
+        nodes[t].right = right;
+        update(t);
+        return t;
+    }
+
+    // Splits t into keys before 'key' and the rest
+    void split(uint32_t t, const Key& key, uint32_t& left, uint32_t& right) {
+        if (t == NIL) {
+            left = right = NIL;
+        } else if (before(nodes[t].key, key)) {
+            split(nodes[t].right, key, nodes[t].right, right);
+            left = t;
+            update(t);
+        } else {
+            split(nodes[t].left, key, left, nodes[t].left);
+            right = t;
+            update(t);
+        }
+    }
+
+    uint32_t merge(uint32_t left, uint32_t right) {
+        if (left == NIL) return right;
+        if (right == NIL) return left;
+        if (nodes[left].priority > nodes[right].priority) {
+            nodes[left].right = merge(nodes[left].right, right);
+            update(left);
+            return left;
+        }
+        nodes[right].left = merge(left, nodes[right].left);
+        update(right);
+        return right;
+    }
+
+    template <typename Fn>
+    void visitInOrder(uint32_t t, size_t& k, Fn& fn) const {
+        if (t == NIL || k == 0) return;
+        visitInOrder(nodes[t].left, k, fn);
+        if (k == 0) return;
+        fn(nodes[t].key.handle);
+        --k;
+        visitInOrder(nodes[t].right, k, fn);
+    }
+};
+
+// ------------------- SoldierStore -------------------
+// Structure-of-arrays roster. The fields that scans touch (rank level, access level,
+// branch) live in contiguous columns indexed by a dense handle; the full Soldier record
+// with its names, specialization, skills and weapons sits in a separate cold area.
+// After a snapshot is attached, cold records of the snapshot's soldiers are built from
+// the mapped image the first time they are used. Secondary indexes and the seniority
+// trees are built on the first query and kept up to date from then on.
+class SoldierStore {
+private:
+    // Hot columns, one entry per handle
+    vector<int32_t> rankLevels;
+    vector<AccessLevel> accessLevels;
+    vector<MilitaryBranch> branches;
+    vector<uint32_t> units;                      // unit id, 0 = unassigned
+
+    mutable ObjectPool<Soldier, 4096> records;   // cold area, addresses stay stable on growth
+    mutable vector<Soldier*> slots;              // handle -> cold record, null until materialized
+    pmr::unsynchronized_pool_resource indexNodes;
+    pmr::unordered_map<string, SoldierHandle> index{&indexNodes};  // soldier ID -> handle, for soldiers added since the snapshot
+    shared_ptr<const SnapshotImage> base;        // mapped snapshot behind handles [0, baseCount)
+    SoldierHandle baseCount = 0;
+    mutable SoldierIndex secondary;
+    mutable bool indexed = false;                // secondary is built and maintained
+    mutable SeniorityIndex seniority;
+    mutable bool ranked = false;                 // seniority is built and maintained
+    vector<string> unitNames{ "" };              // unit id -> name, id 0 is "no unit"
+    unordered_map<string, uint32_t> unitIds;
+    uint32_t generationCount = 0;                // bumped when handles are reassigned
+    uint32_t replacementCount = 0;               // bumped when a record is replaced in place
+
+    SoldierIndex::Fields indexFields(SoldierHandle h) const {
+        if (!slots[h]) {
+            const SnapshotSoldier& rec = base->section<SnapshotSoldier>(SECTION_SOLDIERS)[h];
+            return { branches[h], accessLevels[h], rankLevels[h], rec.experienceYears, base->str(rec.specialization) };
+        }
+        return { branches[h], accessLevels[h], rankLevels[h], slots[h]->getExperienceYears(), slots[h]->getSpecialization() };
+    }
+
+    Soldier& materialize(SoldierHandle h) const {
+        const SnapshotSoldier& rec = base->section<SnapshotSoldier>(SECTION_SOLDIERS)[h];
+        MilitaryRank rank(string(base->str(rec.rankName)), rankLevels[h], accessLevels[h], branches[h]);
+        Soldier& soldier = *records.create(string(base->str(rec.id)), string(base->str(rec.firstName)),
+                                           string(base->str(rec.lastName)), rank, string(base->str(rec.specialization)),
+                                           rec.experienceYears);
+        const SnapshotString* skills = base->section<SnapshotString>(SECTION_SKILLS);
+        for (uint32_t i = 0; i < rec.skillCount && uint64_t(rec.skillsBegin) + i < base->count(SECTION_SKILLS); ++i) {
+            soldier.addSkill(base->str(skills[rec.skillsBegin + i]));
+        }
+        const WeaponId* weapons = base->section<WeaponId>(SECTION_LOADOUTS);
+        for (uint32_t i = 0; i < rec.weaponCount && uint64_t(rec.weaponsBegin) + i < base->count(SECTION_LOADOUTS); ++i) {
+            soldier.assignWeapon(weapons[rec.weaponsBegin + i]);
+        }
+        slots[h] = &soldier;
+        return soldier;
+    }
+
+    SoldierHandle findInSnapshot(string_view soldierId) const {
+        if (!base) return npos;
+        const SoldierHandle* sorted = base->section<SoldierHandle>(SECTION_ID_INDEX);
+        const SnapshotSoldier* recs = base->section<SnapshotSoldier>(SECTION_SOLDIERS);
+        const SoldierHandle* it = lower_bound(sorted, sorted + baseCount, soldierId,
+            [&](SoldierHandle h, string_view key) { return h < baseCount && base->str(recs[h].id) < key; });
+        if (it != sorted + baseCount && *it < baseCount && base->str(recs[*it].id) == soldierId) return *it;
+        return npos;
+    }
+
+    void setHotFields(SoldierHandle h, const MilitaryRank& rank) {
+        rankLevels[h] = rank.getRankLevel();
+        accessLevels[h] = rank.getAccessLevel();
+        branches[h] = rank.getBranch();
+    }
+
+    SeniorityIndex::Key seniorityKey(SoldierHandle h) const {
+        return { rankLevels[h], indexFields(h).experience, h };
+    }
+
+    // Every seniority tree a soldier belongs to: the force, its branch and its unit
+    template <typename Fn>
+    void forEachSeniorityGroup(SoldierHandle h, Fn fn) const {
+        fn(SeniorityIndex::FORCE);
+        fn(SeniorityIndex::branchGroup(branches[h]));
+        if (units[h]) fn(SeniorityIndex::unitGroup(units[h]));
+    }
+
+    // Take a soldier out of the maintained indexes before its indexed fields change,
+    // and put it back afterwards
+    void unindex(SoldierHandle h) {
+        if (indexed) secondary.erase(h, indexFields(h));
+        if (ranked) {
+            SeniorityIndex::Key key = seniorityKey(h);
+            forEachSeniorityGroup(h, [&](uint32_t group) { seniority.erase(group, key); });
+        }
+    }
+
+    void reindex(SoldierHandle h) {
+        if (indexed) secondary.insert(h, indexFields(h));
+        if (ranked) {
+            SeniorityIndex::Key key = seniorityKey(h);
+            forEachSeniorityGroup(h, [&](uint32_t group) { seniority.insert(group, key); });
+        }
+    }
+
+    void buildSeniority() const {
+        vector<vector<SeniorityIndex::Key>> groups(SeniorityIndex::unitGroup(static_cast<uint32_t>(unitNames.size())));
+        groups[SeniorityIndex::FORCE].reserve(slots.size());
+        for (SoldierHandle h = 0; h < slots.size(); ++h) {
+            SeniorityIndex::Key key = seniorityKey(h);
+            forEachSeniorityGroup(h, [&](uint32_t group) { groups[group].push_back(key); });
+        }
+        seniority.clear();
+        for (uint32_t group = 0; group < groups.size(); ++group) seniority.build(group, groups[group]);
+        ranked = true;
+    }
+
+public:
+    static const SoldierHandle npos = UINT32_MAX;
+
+    // Adds a soldier, or replaces the record in place if the ID is already taken
+    SoldierHandle add(Soldier soldier) {
+        SoldierHandle h = find(soldier.getId());
+        if (h != npos) {  // the soldier keeps its unit
+            Soldier& record = get(h);
+            ++replacementCount;
+            unindex(h);
+            record = move(soldier);
+            setHotFields(h, record.getRank());
+            reindex(h);
+            return h;
+        }
+        h = static_cast<SoldierHandle>(slots.size());
+        Soldier* record = records.create(move(soldier));
+        slots.push_back(record);
+        rankLevels.push_back(0);
+        accessLevels.push_back(AccessLevel::CONFIDENTIAL);
+        branches.push_back(MilitaryBranch::ARMY);
+        units.push_back(0);
+        setHotFields(h, record->getRank());
+        index.emplace(record->getId(), h);
+        reindex(h);
+        return h;
+    }
+
+    // Gives a soldier a new rank name and level; access level and branch are kept
+    void promote(SoldierHandle h, const string& rankName, int rankLevel) {
+        Soldier& record = get(h);
+        unindex(h);
+        record.setRank(MilitaryRank(rankName, rankLevel, accessLevels[h], branches[h]));
+        setHotFields(h, record.getRank());
+        reindex(h);
+    }
+
+    void setUnit(SoldierHandle h, uint32_t unit) {
+        unindex(h);
+        units[h] = unit;
+        reindex(h);
+    }
+
+    // Unit registry: ids are dense and start at 1
+    uint32_t internUnit(const string& name) {
+        auto it = unitIds.find(name);
+        if (it != unitIds.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(unitNames.size());
+        unitNames.push_back(name);
+        unitIds.emplace(name, id);
+        return id;
+    }
+
+    uint32_t findUnit(const string& name) const {
+        auto it = unitIds.find(name);
+        return (it != unitIds.end()) ? it->second : 0;
+    }
+
+    // Handles held elsewhere are only valid while generation() is unchanged; a soldier's
+    // access level may have changed if replacements() has moved
+    uint32_t generation() const { return generationCount; }
+    uint32_t replacements() const { return replacementCount; }
+
+    const string& unitName(uint32_t unit) const { return unitNames[unit]; }
+    size_t unitCount() const { return unitNames.size() - 1; }
+    uint32_t unit(SoldierHandle h) const { return units[h]; }
+
+    // Seniority order within a group (SeniorityIndex::FORCE, branchGroup, unitGroup)
+    const SeniorityIndex& seniorityIndex() const {
+        if (!ranked) buildSeniority();
+        return seniority;
+    }
+
+    // 0-based position of a soldier in its group's seniority order
+    size_t seniorityRank(uint32_t group, SoldierHandle h) const {
+        return seniorityIndex().countBefore(group, seniorityKey(h));
+    }
+
+    // Soldiers matching every condition of the query, in handle order
+    vector<SoldierHandle> query(const SoldierQuery& q) const {
+        if (!indexed) {
+            for (SoldierHandle h = 0; h < slots.size(); ++h) secondary.insert(h, indexFields(h));
+            indexed = true;
+        }
+        return secondary.query(q, slots.size());
+    }
+
+    // Makes room for n more soldiers ahead of a bulk insert. Grows at least geometrically
+    // so that repeated calls stay amortized O(1) per soldier.
+    void reserve(size_t n) {
+        size_t total = slots.size() + n;
+        if (total > slots.capacity()) {
+            total = max(total, 2 * slots.capacity());
+            rankLevels.reserve(total);
+            accessLevels.reserve(total);
+            branches.reserve(total);
+            units.reserve(total);
+            slots.reserve(total);
+        }
+        size_t indexTotal = index.size() + n;
+        if (indexTotal > index.bucket_count() * index.max_load_factor()) index.reserve(max(indexTotal, 2 * index.size()));
+    }
+
+    SoldierHandle find(const string& soldierId) const {
+        auto it = index.find(soldierId);
+        return (it != index.end()) ? it->second : findInSnapshot(soldierId);
+    }
+
+    Soldier& get(SoldierHandle h) { return slots[h] ? *slots[h] : materialize(h); }
+    const Soldier& get(SoldierHandle h) const { return slots[h] ? *slots[h] : materialize(h); }
+    size_t size() const { return slots.size(); }
+
+    // A soldier's skills, read from the mapped snapshot if the record is not built yet
+    void copySkills(SoldierHandle h, SkillList& out) const {
+        if (slots[h]) {
+            out = slots[h]->getSkills();
+            return;
+        }
+        out.clear();
+        const SnapshotSoldier& rec = base->section<SnapshotSoldier>(SECTION_SOLDIERS)[h];
+        const SnapshotString* skills = base->section<SnapshotString>(SECTION_SKILLS);
+        for (uint32_t i = 0; i < rec.skillCount && uint64_t(rec.skillsBegin) + i < base->count(SECTION_SKILLS); ++i) {
+            out.push_back(SkillNames::intern(base->str(skills[rec.skillsBegin + i])));
+        }
+    }
+
+    // Replaces the contents with a mapped snapshot. Hot columns are bulk-copied;
+    // cold records stay in the image until they are first used.
+    void attachSnapshot(shared_ptr<const SnapshotImage> image) {
+        records.clear();
+        index.clear();
+        secondary.clear();
+        indexed = false;
+        seniority.clear();
+        ranked = false;
+        ++generationCount;
+        base = move(image);
+        baseCount = static_cast<SoldierHandle>(base->count(SECTION_SOLDIERS));
+        const int32_t* levels = base->section<int32_t>(SECTION_RANK_LEVELS);
+        const AccessLevel* access = base->section<AccessLevel>(SECTION_ACCESS_LEVELS);
+        const MilitaryBranch* branch = base->section<MilitaryBranch>(SECTION_BRANCHES);
+        rankLevels.assign(levels, levels + baseCount);
+        accessLevels.assign(access, access + baseCount);
+        branches.assign(branch, branch + baseCount);
+        slots.assign(baseCount, nullptr);
+
+        unitNames.assign(1, "");
+        unitIds.clear();
+        const SnapshotString* names = base->section<SnapshotString>(SECTION_UNIT_NAMES);
+        for (uint64_t i = 0; i < base->count(SECTION_UNIT_NAMES); ++i) internUnit(string(base->str(names[i])));
+        if (base->count(SECTION_UNITS) == baseCount) {
+            const uint32_t* unit = base->section<uint32_t>(SECTION_UNITS);
+            units.assign(unit, unit + baseCount);
+            for (uint32_t& u : units) {
+                if (u >= unitNames.size()) u = 0;
+            }
+        } else {
+            units.assign(baseCount, 0);  // version 2 snapshot
+        }
+    }
+
+    // Report lines come from the record if it is materialized and straight from the
+    // mapped snapshot otherwise, so a full-roster report neither allocates nor builds
+    // cold records.
+    void writeRosterLine(ReportWriter& out, SoldierHandle h) const {
+        if (slots[h]) {
+            slots[h]->write(out);
+        } else {
+            const SnapshotSoldier& rec = base->section<SnapshotSoldier>(SECTION_SOLDIERS)[h];
+            out << base->str(rec.id) << ": " << base->str(rec.firstName) << ' ' << base->str(rec.lastName) << " - ";
+            MilitaryRank::write(out, base->str(rec.rankName), rankLevels[h], accessLevels[h]);
+        }
+        out << '\n';
+    }
+
+    void writeRoster(ReportWriter& out) const {
+        for (SoldierHandle h = 0; h < slots.size(); ++h) writeRosterLine(out, h);
+    }
+
+    // One line per soldier: "<id>: weapon, weapon, ..." (or "(none)")
+    void writeLoadouts(ReportWriter& out, const WeaponCatalog& catalog) const {
+        const WeaponId* snapshotLoadouts = base ? base->section<WeaponId>(SECTION_LOADOUTS) : nullptr;
+        for (SoldierHandle h = 0; h < slots.size(); ++h) {
+            const WeaponId* weapons;
+            size_t count;
+            if (slots[h]) {
+                out << slots[h]->getId();
+                weapons = slots[h]->getWeapons().data();
+                count = slots[h]->getWeapons().size();
+            } else {
+                const SnapshotSoldier& rec = base->section<SnapshotSoldier>(SECTION_SOLDIERS)[h];
+                out << base->str(rec.id);
+                weapons = snapshotLoadouts + rec.weaponsBegin;
+                count = min<uint64_t>(rec.weaponCount, base->count(SECTION_LOADOUTS) - min<uint64_t>(rec.weaponsBegin, base->count(SECTION_LOADOUTS)));
+            }
+            out << ": ";
+            if (count == 0) out << "(none)";
+            for (size_t i = 0; i < count; ++i) {
+                if (i) out << ", ";
+                out << catalog.get(weapons[i]).getName();
+            }
+            out << '\n';
+        }
+    }
+
+    int rankLevel(SoldierHandle h) const { return rankLevels[h]; }
+    AccessLevel accessLevel(SoldierHandle h) const { return accessLevels[h]; }
+    MilitaryBranch branch(SoldierHandle h) const { return branches[h]; }
+
+    // Whole columns, for scans
+    const vector<int32_t>& rankLevelColumn() const { return rankLevels; }
+    const vector<AccessLevel>& accessLevelColumn() const { return accessLevels; }
+    const vector<MilitaryBranch>& branchColumn() const { return branches; }
+    const vector<uint32_t>& unitColumn() const { return units; }
+};
+
+// ------------------- InventoryTransaction -------------------
+// Takes several weapons and supplies from an Inventory all together or not at all.
+// reserve() takes the items out of stock, commit() keeps them and abort() (or
+// destroying an uncommitted transaction) puts them back.
+//
+// Reservation is optimistic: each involved shard is locked on its own just long enough
+// to check the stock and remember where each item's count lives, together with the
+// shard's version. Then all involved shards are locked in index order and, if no
+// version moved, the counts are decremented through the remembered pointers without
+// another lookup. A moved version means someone else changed one of the shards in
+// between, and the reservation starts over; after a few such conflicts it does the
+// checks with the locks already held so it cannot starve. Stock can never go negative
+// because counts are only decremented after a check against the current version.
+class InventoryTransaction {
+public:
+    enum class Status { OPEN, RESERVED, COMMITTED, ABORTED };
+
+    explicit InventoryTransaction(Inventory& inventory) : inventory(&inventory) {}
+    InventoryTransaction(const InventoryTransaction&) = delete;
+    InventoryTransaction& operator=(const InventoryTransaction&) = delete;
+    ~InventoryTransaction() { abort(); }
+
+    // Adds to the request; only while the transaction is open
+    void addWeapon(WeaponId weapon, int quantity) { add(true, weapon, string(), quantity); }
+    void addSupply(const string& supplyId, int quantity) { add(false, 0, supplyId, quantity); }
+
+    // Takes every requested item out of stock, or nothing. On failure the first item
+    // that was short is available from shortItem().
+    bool reserve() {
+        if (status != Status::OPEN) return false;
+        // Involved shards in index order; there are at most SHARD_COUNT of them
+        size_t shards[Inventory::SHARD_COUNT], shardCount = 0;
+        uint64_t versions[Inventory::SHARD_COUNT];
+        for (size_t shard = 0; shard < Inventory::SHARD_COUNT; ++shard) {
+            for (const Line& line : lines) {
+                if (line.shard == shard) {
+                    shards[shardCount++] = shard;
+                    break;
+                }
+            }
+        }
+
+        for (int attempt = 0;; ++attempt) {
+            bool pessimistic = attempt >= MAX_OPTIMISTIC_ATTEMPTS;
+            if (!pessimistic) {
+                for (size_t i = 0; i < shardCount; ++i) {
+                    Inventory::Shard& shard = inventory->shards[shards[i]];
+                    lock_guard<mutex> guard(shard.lock);
+                    versions[i] = shard.version;
+                    if (!locate(shards[i])) return false;
+                }
+            }
+
+            unique_lock<mutex> locks[Inventory::SHARD_COUNT];
+            bool current = true;
+            for (size_t i = 0; i < shardCount; ++i) {
+                Inventory::Shard& shard = inventory->shards[shards[i]];
+                locks[i] = unique_lock<mutex>(shard.lock);
+                current = current && shard.version == versions[i];
+            }
+            if (pessimistic) {
+                for (size_t i = 0; i < shardCount; ++i) {
+                    if (!locate(shards[i])) return false;
+                }
+            } else if (!current) {
+                ++conflictCount;
+                continue;
+            }
+            apply();
+            for (size_t i = 0; i < shardCount; ++i) ++inventory->shards[shards[i]].version;
+            status = Status::RESERVED;
+            return true;
+        }
+    }
+
+    // Keeps a reservation; the items stay out of stock
+    bool commit() {
+        if (status != Status::RESERVED) return false;
+        status = Status::COMMITTED;
+        return true;
+    }
+
+    // Returns reserved items to stock; a transaction that was never reserved just closes
+    void abort() {
+        if (status == Status::RESERVED) {
+            for (const Line& line : lines) {
+                if (line.weapon) {
+                    inventory->addWeapon(line.weaponId, line.quantity);
+                } else {
+                    inventory->addSupply(line.supplyId, line.description, line.quantity);
+                }
+            }
+        }
+        if (status != Status::COMMITTED) status = Status::ABORTED;
+    }
+
+    Status getStatus() const { return status; }
+    size_t conflicts() const { return conflictCount; }  // optimistic attempts that had to start over
+
+    // The item reserve() failed on, as "weapon <name>" or "supply <id>"
+    string shortItem() const {
+        if (shortLine == SIZE_MAX) return string();
+        const Line& line = lines[shortLine];
+        return line.weapon ? "weapon " + inventory->catalog->get(line.weaponId).getName() : "supply " + line.supplyId;
+    }
+
+private:
+    static const int MAX_OPTIMISTIC_ATTEMPTS = 8;
+
+    struct Line {
+        bool weapon;
+        WeaponId weaponId;
+        string supplyId, description;
+        int quantity;
+        size_t shard;
+        int* count = nullptr;  // stock count inside the shard, valid while its version holds
+    };
+
+    Inventory* inventory;
+    vector<Line> lines;
+    Status status = Status::OPEN;
+    size_t conflictCount = 0;
+    size_t shortLine = SIZE_MAX;
+
+    void add(bool weapon, WeaponId weaponId, const string& supplyId, int quantity) {
+        if (status != Status::OPEN || quantity <= 0) return;
+        for (Line& line : lines) {
+            if (line.weapon == weapon && line.weaponId == weaponId && line.supplyId == supplyId) {
+                line.quantity += quantity;
+                return;
+            }
+        }
+        size_t shard = weapon ? weaponId % Inventory::SHARD_COUNT : hash<string>()(supplyId) % Inventory::SHARD_COUNT;
+        if (lines.empty()) lines.reserve(4);
+        lines.push_back({ weapon, weaponId, supplyId, string(), quantity, shard });
+    }
+
+    // Checks the lines in one shard against its stock and remembers where their counts
+    // live; the shard is locked by the caller
+    bool locate(size_t shardIndex) {
+        Inventory::Shard& shard = inventory->shards[shardIndex];
+        for (size_t i = 0; i < lines.size(); ++i) {
+            Line& line = lines[i];
+            if (line.shard != shardIndex) continue;
+            line.count = nullptr;
+            if (line.weapon) {
+                auto it = shard.weapons.find(line.weaponId);
+                if (it != shard.weapons.end()) line.count = &it->second;
+            } else {
+                auto it = shard.supplies.find(line.supplyId);
+                if (it != shard.supplies.end()) {
+                    line.count = &it->second.second;
+                    line.description = it->second.first;
+                }
+            }
+            if (!line.count || *line.count < line.quantity) {
+                shortLine = i;
+                status = Status::ABORTED;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Decrements every line and drops emptied entries; all involved shards are locked
+    void apply() {
+        Journal* journal = inventory->journal;
+        for (Line& line : lines) {
+            *line.count -= line.quantity;
+            Inventory::Shard& shard = inventory->shards[line.shard];
+            if (line.weapon) {
+                if (journal) journal->append(JournalOp::REMOVE_WEAPON, line.weaponId, line.quantity);
+                if (*line.count <= 0) shard.weapons.erase(line.weaponId);
+            } else {
+                if (journal) journal->append(JournalOp::REMOVE_SUPPLY, line.supplyId, line.quantity);
+                if (*line.count <= 0) shard.supplies.erase(line.supplyId);
+            }
+            line.count = nullptr;
+        }
+    }
+};
+
+// ------------------- AccessIndex -------------------
+// Precomputed clearance checks: for every AccessLevel, bitmaps of the warzones, weapon
+// types and inventories visible at that level. Entries are addressed by their dense slot
+// (warzone slot, WeaponId, inventory slot). Clearance is monotonic, so an entry that
+// requires level L is set in the bitmaps of L and of every level above it.
+class AccessIndex {
+public:
+    struct View {
+        Bitmap warzones, weapons, inventories;
+    };
+
+    void addWarzone(size_t slot, AccessLevel required) { update(&View::warzones, slot, required); }
+    void addWeapon(WeaponId weapon, AccessLevel required) { update(&View::weapons, weapon, required); }
+    void addInventory(size_t slot, AccessLevel required) { update(&View::inventories, slot, required); }
+
+    // Everything a soldier with this clearance can access
+    const View& visibleTo(AccessLevel level) const { return levels[static_cast<int>(level) - 1]; }
+
+private:
+    View levels[ACCESS_LEVEL_COUNT];
+
+    void update(Bitmap View::*kind, size_t slot, AccessLevel required) {
+        for (int l = 0; l < ACCESS_LEVEL_COUNT; ++l) {
+            if (l + 1 >= static_cast<int>(required)) {
+                (levels[l].*kind).set(slot);
+            } else {
+                (levels[l].*kind).reset(slot);  // slot reused by a stricter entry
+            }
+        }
+    }
+};
+
+// ------------------- LoadoutOptimizer -------------------
+// Suggests loadouts from inventory stock. A loadout holds at most 'slots' weapons,
+// including those the soldier already carries, and at most one weapon of each type
+// (a rifle and a sidearm combine, two rifles do not). Its score is the sum of
+// weights . (damage, range, accuracy) over its weapons. Soldiers only get weapons
+// their clearance allows and never more than is in stock; soldiers added first
+// (most senior) get first pick when stock runs short.
+struct LoadoutWeights {
+    float damage = 1.0f, range = 0.1f, accuracy = 1.0f;
+};
+
+class LoadoutOptimizer {
+public:
+    struct Plan {
+        size_t slots = 0;
+        vector<WeaponId> picks;  // 'slots' entries per soldier, padded with WeaponCatalog::npos
+        vector<float> scores;    // score of the new weapons, per soldier
+        size_t weapons = 0;
+        double totalScore = 0;
+    };
+
+    LoadoutOptimizer(const WeaponCatalog& catalog, const Inventory& inventory, const LoadoutWeights& weights, size_t slots)
+        : slots(slots), stock(catalog.size(), 0) {
+        inventory.forEachWeapon([&](WeaponId id, int quantity) {
+            if (id < stock.size()) stock[id] = quantity;
+        });
+
+        // Catalog as columns, so the scoring loop below is a plain vectorizable kernel
+        size_t n = catalog.size();
+        vector<float> damage(n), range(n), accuracy(n);
+        typeOf.resize(n);
+        unordered_map<string, uint32_t> typeIds;
+        for (WeaponId id = 0; id < n; ++id) {
+            const Weapon& weapon = catalog.get(id);
+            damage[id] = static_cast<float>(weapon.getDamageRating());
+            range[id] = static_cast<float>(weapon.getRange());
+            accuracy[id] = static_cast<float>(weapon.getAccuracy());
+            typeOf[id] = typeIds.emplace(weapon.getType(), static_cast<uint32_t>(typeIds.size())).first->second;
+        }
+        score.resize(n);
+        const float wd = weights.damage, wr = weights.range, wa = weights.accuracy;
+        const float *d = damage.data(), *r = range.data(), *a = accuracy.data();
+        float* out = score.data();
+        for (size_t i = 0; i < n; ++i) out[i] = wd * d[i] + wr * r[i] + wa * a[i];
+
+        // One best-first candidate list per clearance level; weapons that cannot add to
+        // a score or are out of stock are never candidates
+        for (int level = 0; level < ACCESS_LEVEL_COUNT; ++level) {
+            for (WeaponId id = 0; id < n; ++id) {
+                if (score[id] > 0 && stock[id] > 0 && static_cast<int>(catalog.get(id).getRequiredAccess()) <= level + 1) {
+                    ranking[level].push_back(id);
+                }
+            }
+            stable_sort(ranking[level].begin(), ranking[level].end(),
+                        [&](WeaponId x, WeaponId y) { return score[x] > score[y]; });
+        }
+    }
+
+    // Queues a soldier; call in priority order
+    void addSoldier(AccessLevel access, const Loadout& held) {
+        soldierAccess.push_back(access);
+        heldBegin.push_back(static_cast<uint32_t>(heldTypes.size()));
+        for (WeaponId weapon : held) {
+            if (weapon < typeOf.size()) heldTypes.push_back(typeOf[weapon]);
+        }
+        heldEnd.push_back(static_cast<uint32_t>(heldTypes.size()));
+        heldCount.push_back(static_cast<uint32_t>(held.size()));
+    }
+
+    size_t soldierCount() const { return soldierAccess.size(); }
+
+    // Each soldier's best loadout is searched against the starting stock in parallel.
+    // A sequential pass in priority order then takes those picks from the remaining
+    // stock, searching again only for soldiers whose picks ran out.
+    Plan solve() const {
+        Plan plan;
+        size_t n = soldierAccess.size();
+        plan.slots = slots;
+        plan.picks.assign(n * slots, WeaponCatalog::npos);
+        plan.scores.assign(n, 0.0f);
+
+        auto searchRange = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) plan.scores[i] = search(i, stock, &plan.picks[i * slots]);
+        };
+        size_t workers = (n >= PARALLEL_THRESHOLD) ? max(1u, thread::hardware_concurrency()) : 1;
+        size_t per = (n + workers - 1) / workers;
+        vector<future<void>> running;
+        for (size_t begin = per; begin < n; begin += per) {
+            running.push_back(async(launch::async, searchRange, begin, min(n, begin + per)));
+        }
+        searchRange(0, min(n, per));
+        for (future<void>& f : running) f.get();
+
+        vector<int> remaining = stock;
+        for (size_t i = 0; i < n; ++i) {
+            WeaponId* picks = &plan.picks[i * slots];
+            bool available = true;
+            for (size_t k = 0; k < slots && picks[k] != WeaponCatalog::npos; ++k) {
+                if (remaining[picks[k]] <= 0) available = false;
+            }
+            if (!available) plan.scores[i] = search(i, remaining, picks);
+            for (size_t k = 0; k < slots && picks[k] != WeaponCatalog::npos; ++k) {
+                --remaining[picks[k]];
+                ++plan.weapons;
+            }
+            plan.totalScore += plan.scores[i];
+        }
+        return plan;
+    }
+
+    float weaponScore(WeaponId weapon) const { return score[weapon]; }
+
+private:
+    static const size_t PARALLEL_THRESHOLD = 1024;  // smaller batches are not worth a thread
+
+    size_t slots;
+    vector<int> stock;        // by WeaponId, at construction
+    vector<uint32_t> typeOf;  // WeaponId -> dense weapon type
+    vector<float> score;      // by WeaponId
+    vector<WeaponId> ranking[ACCESS_LEVEL_COUNT];
+    vector<AccessLevel> soldierAccess;
+    vector<uint32_t> heldBegin, heldEnd, heldCount;  // per soldier: range in heldTypes, weapons carried
+    vector<uint32_t> heldTypes;
+
+    // Greedy by score, one weapon per type not yet carried. Choosing the best of each
+    // type in score order is optimal for a per-type limit with additive scores.
+    float search(size_t soldier, const vector<int>& available, WeaponId* picks) const {
+        size_t free = slots > heldCount[soldier] ? slots - heldCount[soldier] : 0;
+        const uint32_t* heldFrom = heldTypes.data() + heldBegin[soldier];
+        const uint32_t* heldTo = heldTypes.data() + heldEnd[soldier];
+        size_t chosen = 0;
+        float total = 0;
+        for (WeaponId weapon : ranking[static_cast<int>(soldierAccess[soldier]) - 1]) {
+            if (chosen == free) break;
+            if (available[weapon] <= 0) continue;
+            uint32_t type = typeOf[weapon];
+            bool taken = find(heldFrom, heldTo, type) != heldTo;
+            for (size_t k = 0; k < chosen && !taken; ++k) taken = typeOf[picks[k]] == type;
+            if (taken) continue;
+            picks[chosen++] = weapon;
+            total += score[weapon];
+        }
+        fill(picks + chosen, picks + slots, WeaponCatalog::npos);
+        return total;
+    }
+};
+
+// ------------------- Work stealing -------------------
+// Runs fn(begin, end) over [0, count) on every core. Each worker starts with an equal
+// share in its own deque of ranges, halves the newest range until it is at most 'grain'
+// long and runs that, leaving the other halves queued; a worker that runs dry steals
+// the oldest, largest range from another. Uneven items even out without a central queue.
+template <typename Fn>
+void parallelForStealing(size_t count, size_t grain, Fn fn) {
+    size_t workers = min<size_t>(max(1u, thread::hardware_concurrency()), (count + grain - 1) / grain);
+    if (workers <= 1) {
+        if (count > 0) fn(0, count);
+        return;
+    }
+
+    struct alignas(64) Queue {
+        mutex lock;
+        deque<pair<size_t, size_t>> ranges;
+    };
+    vector<Queue> queues(workers);
+    for (size_t w = 0; w < workers; ++w) queues[w].ranges.emplace_back(count * w / workers, count * (w + 1) / workers);
+    atomic<size_t> remaining{count};
+
+    auto work = [&](size_t self) {
+        while (remaining.load(memory_order_acquire) > 0) {
+            pair<size_t, size_t> range;
+            bool found = false;
+            {
+                lock_guard<mutex> guard(queues[self].lock);
+                if (!queues[self].ranges.empty()) {
+                    range = queues[self].ranges.back();
+                    queues[self].ranges.pop_back();
+                    found = true;
+                }
+            }
+            for (size_t k = 1; k < workers && !found; ++k) {
+                Queue& victim = queues[(self + k) % workers];
+                lock_guard<mutex> guard(victim.lock);
+                if (!victim.ranges.empty()) {
+                    range = victim.ranges.front();
+                    victim.ranges.pop_front();
+                    found = true;
+                }
+            }
+            if (!found) {  // the last ranges are still running elsewhere
+                this_thread::yield();
+                continue;
+            }
+            while (range.second - range.first > grain) {
+                size_t mid = range.first + (range.second - range.first) / 2;
+                lock_guard<mutex> guard(queues[self].lock);
+                queues[self].ranges.emplace_back(mid, range.second);
+                range.second = mid;
+            }
+            fn(range.first, range.second);
+            remaining.fetch_sub(range.second - range.first, memory_order_acq_rel);
+        }
+    };
+    vector<future<void>> running;
+    for (size_t w = 1; w < workers; ++w) running.push_back(async(launch::async, work, w));
+    work(0);
+    for (future<void>& f : running) f.get();
+}
+
+// ------------------- DeploymentScheduler -------------------
+// Soldier -> warzone deployments. A soldier in the deployment pool is either waiting or
+// deployed to one warzone. A warzone takes soldiers who pass its access check and have
+// all of its required skills, up to its capacity. Soldiers with the same access level and
+// skills qualify for the same warzones whatever the warzones require, so planning works
+// on those classes rather than on single soldiers, and a warzone change only re-tests
+// each class against that one warzone. A bulk solve is one max-flow over pool -> class ->
+// warzone -> capacity; a re-plan after a single change shifts soldiers along the shortest
+// chain of warzones that frees a place. Pool soldiers may be moved between warzones they
+// qualify for to make room. setState() and setZone() change the plan without re-planning
+// (journal replay, snapshot load); the planning calls report every move so the caller can
+// journal it.
+class DeploymentScheduler {
+public:
+    static constexpr uint32_t OFF = UINT32_MAX;          // not in the pool
+    static constexpr uint32_t WAITING = UINT32_MAX - 1;  // in the pool, not deployed
+
+    struct Zone {
+        AccessLevel access = AccessLevel::CONFIDENTIAL;
+        uint32_t capacity = 0;  // 0 = unlimited
+        SkillList skills;
+    };
+
+    typedef vector<pair<SoldierHandle, uint32_t>> Moves;  // soldier, new state
+
+    // Same rule as Warzone::canAccess, plus the skill requirement
+    static bool qualifies(AccessLevel access, const SkillList& skills, const Zone& zone) {
+        if (static_cast<int>(access) < static_cast<int>(zone.access)) return false;
+        for (SkillId required : zone.skills) {
+            if (find(skills.begin(), skills.end(), required) == skills.end()) return false;
+        }
+        return true;
+    }
+
+    void clear() {
+        zones.clear();
+        loads.clear();
+        states.clear();
+        waiting = 0;
+        changedZones.clear();
+        dirty = true;
+    }
+
+    // Re-tests the classes against this warzone only; rebalance() then moves soldiers
+    void setZone(uint32_t slot, const Zone& zone) {
+        uint32_t first = slot;
+        if (slot >= zones.size()) {
+            first = static_cast<uint32_t>(zones.size());
+            zones.resize(slot + 1);
+            loads.resize(slot + 1, 0);
+            zoneGroups.resize(slot + 1);
+        }
+        zones[slot] = zone;
+        for (uint32_t z = first; z <= slot; ++z) {
+            for (uint32_t c = 0; !dirty && c < classCount(); ++c) {
+                if (qualifies(classAccess[c], classSkills[c], zones[z])) classZones[c].set(z);
+                else classZones[c].reset(z);
+            }
+            changedZones.push_back(z);
+        }
+    }
+
+    // Moves one soldier without re-planning; a zone state must be a known slot
+    void setState(SoldierHandle h, uint32_t state) {
+        ensure(h);
+        assignState(h, state);
+        if (state != OFF && state != WAITING) changedZones.push_back(state);  // may now be over capacity
+        dirty = true;
+    }
+
+    uint32_t state(SoldierHandle h) const { return h < states.size() ? states[h] : OFF; }
+    const Zone& zone(uint32_t slot) const { return zones[slot]; }
+    size_t zoneCount() const { return zones.size(); }
+    uint32_t load(uint32_t slot) const { return loads[slot]; }
+    size_t waitingCount() const { return waiting; }
+    bool hasRoom(uint32_t slot) const { return zones[slot].capacity == 0 || loads[slot] < zones[slot].capacity; }
+
+    // Adds soldiers to the pool and re-plans the whole pool for the most deployments,
+    // keeping soldiers where they are as far as that allows. A pool that is planned
+    // already deploys all it can, so a few added soldiers only need chains of their own.
+    void solve(const vector<SoldierHandle>& added, const SoldierStore& store, Moves& moves) {
+        for (SoldierHandle h : added) ensure(h);
+        if (!dirty && changedZones.empty() && added.size() <= FEW_ADDED) {
+            log = &moves;
+            for (SoldierHandle h : added) {
+                if (states[h] != OFF) continue;
+                classify(h, store);
+                relocate(h, WAITING);
+            }
+            placeWaiting();
+            log = nullptr;
+            return;
+        }
+        vector<uint32_t> before = states;
+        for (SoldierHandle h : added) {
+            if (states[h] != OFF) continue;
+            if (dirty) {
+                assignState(h, WAITING);
+            } else {
+                classify(h, store);
+                relocate(h, WAITING);
+            }
+        }
+        if (dirty) refresh(store);
+
+        // Classes qualified for the same warzones share a node
+        size_t slots = zones.size();
+        unordered_map<string, uint32_t> nodeIds;
+        vector<uint32_t> nodeOf(classCount()), firstClass;
+        for (uint32_t c = 0; c < classCount(); ++c) {
+            string key;
+            classZones[c].forEach([&](size_t z) { key.append(reinterpret_cast<const char*>(&z), sizeof(z)); });
+            auto interned = nodeIds.emplace(move(key), static_cast<uint32_t>(firstClass.size()));
+            if (interned.second) firstClass.push_back(c);
+            nodeOf[c] = interned.first->second;
+        }
+        size_t nodes = firstClass.size();
+        vector<vector<uint32_t>> nodeGroups(nodes);
+        vector<int64_t> pooled(nodes, 0);
+        for (uint32_t g = 0; g < groups.size(); ++g) {
+            nodeGroups[nodeOf[groups[g].cls]].push_back(g);
+            pooled[nodeOf[groups[g].cls]] += static_cast<int64_t>(groups[g].soldiers.size());
+        }
+
+        const int64_t unlimited = INT64_MAX / 4;
+        FlowGraph graph(nodes + slots + 2);
+        uint32_t source = 0, sink = static_cast<uint32_t>(nodes + slots + 1);
+        vector<vector<pair<uint32_t, size_t>>> edges(nodes);  // per node: warzone, edge to it
+        for (uint32_t n = 0; n < nodes; ++n) {
+            graph.addEdge(source, 1 + n, pooled[n]);
+            classZones[firstClass[n]].forEach([&](size_t z) {
+                edges[n].emplace_back(static_cast<uint32_t>(z), graph.addEdge(1 + n, static_cast<uint32_t>(1 + nodes + z), unlimited));
+            });
+        }
+        for (uint32_t z = 0; z < slots; ++z) {
+            graph.addEdge(static_cast<uint32_t>(1 + nodes + z), sink, zones[z].capacity ? zones[z].capacity : unlimited);
+        }
+        graph.maxFlow(source, sink);
+
+        // Flow per (node, warzone) is how many of the node's soldiers go there; soldiers
+        // already there stay as far as that allows
+        vector<int64_t> quota(slots, 0);
+        for (uint32_t n = 0; n < nodes; ++n) {
+            for (const auto& [z, edge] : edges[n]) quota[z] = graph.flowOn(edge);
+            vector<SoldierHandle> unplaced;
+            for (uint32_t g : nodeGroups[n]) {
+                const Group& group = groups[g];
+                size_t keep = 0;
+                if (group.state != WAITING) {
+                    keep = static_cast<size_t>(min<int64_t>(quota[group.state], static_cast<int64_t>(group.soldiers.size())));
+                    quota[group.state] -= static_cast<int64_t>(keep);
+                }
+                unplaced.insert(unplaced.end(), group.soldiers.begin() + keep, group.soldiers.end());
+            }
+            size_t next = 0;
+            for (SoldierHandle h : unplaced) {
+                while (next < edges[n].size() && quota[edges[n][next].first] == 0) ++next;
+                if (next < edges[n].size()) {
+                    --quota[edges[n][next].first];
+                    relocate(h, edges[n][next].first);
+                } else if (states[h] != WAITING) {
+                    relocate(h, WAITING);
+                }
+            }
+            for (const auto& edge : edges[n]) quota[edge.first] = 0;
+        }
+        changedZones.clear();  // every soldier now qualifies for a warzone with room for them
+
+        for (SoldierHandle h = 0; h < states.size(); ++h) {
+            if (h >= before.size() ? states[h] != OFF : states[h] != before[h]) moves.emplace_back(h, states[h]);
+        }
+    }
+
+    // Re-plans after warzone limits changed: soldiers of a changed warzone who no longer
+    // qualify or are over its capacity go back to waiting, then waiting soldiers are
+    // placed where possible
+    void rebalance(const SoldierStore& store, Moves& moves) {
+        log = &moves;
+        if (dirty) refresh(store);
+        sort(changedZones.begin(), changedZones.end());
+        changedZones.erase(unique(changedZones.begin(), changedZones.end()), changedZones.end());
+        for (uint32_t z : changedZones) evict(z);
+        changedZones.clear();
+        placeWaiting();
+        log = nullptr;
+    }
+
+    // Re-plans after one soldier's record changed
+    void replanSoldier(SoldierHandle h, const SoldierStore& store, Moves& moves) {
+        if (state(h) == OFF) return;
+        log = &moves;
+        if (dirty) {
+            refresh(store);
+        } else {
+            leave(h);
+            classify(h, store);
+            join(h);
+        }
+        if (states[h] != WAITING && !qualified(classOf[h], states[h])) relocate(h, WAITING);
+        placeWaiting();
+        log = nullptr;
+    }
+
+    // Takes a soldier out of the pool; the place is refilled from waiting soldiers
+    bool withdraw(SoldierHandle h, const SoldierStore& store, Moves& moves) {
+        if (state(h) == OFF) return false;
+        log = &moves;
+        if (dirty) refresh(store);
+        relocate(h, OFF);
+        placeWaiting();
+        log = nullptr;
+        return true;
+    }
+
+    // Deploys a soldier to a warzone that has room; the caller checks qualification
+    bool place(SoldierHandle h, uint32_t slot, const SoldierStore& store, Moves& moves) {
+        if (state(h) == slot) return true;
+        if (!hasRoom(slot)) return false;
+        ensure(h);
+        log = &moves;
+        if (dirty) refresh(store);
+        if (states[h] == OFF) classify(h, store);
+        relocate(h, slot);
+        placeWaiting();
+        log = nullptr;
+        return true;
+    }
+
+private:
+    // Dinic's max-flow; the graph is classes x warzones, so recursion stays shallow
+    class FlowGraph {
+    public:
+        explicit FlowGraph(size_t nodes) : out(nodes), level(nodes), next(nodes) {}
+
+        size_t addEdge(uint32_t from, uint32_t to, int64_t capacity) {
+            out[from].push_back(static_cast<uint32_t>(edges.size()));
+            edges.push_back({ to, capacity });
+            out[to].push_back(static_cast<uint32_t>(edges.size()));
+            edges.push_back({ from, 0 });
+            return edges.size() - 2;
+        }
+
+        int64_t flowOn(size_t edge) const { return edges[edge ^ 1].capacity; }
+
+        int64_t maxFlow(uint32_t source, uint32_t sink) {
+            int64_t total = 0;
+            while (buildLevels(source, sink)) {
+                fill(next.begin(), next.end(), 0);
+                while (int64_t pushed = push(source, sink, INT64_MAX)) total += pushed;
+            }
+            return total;
+        }
+
+    private:
+        struct Edge {
+            uint32_t to;
+            int64_t capacity;  // residual; edge e and e ^ 1 are a pair
+        };
+        vector<Edge> edges;
+        vector<vector<uint32_t>> out;
+        vector<int> level;
+        vector<size_t> next;
+
+        bool buildLevels(uint32_t source, uint32_t sink) {
+            fill(level.begin(), level.end(), -1);
+            vector<uint32_t> queue{ source };
+            level[source] = 0;
+            for (size_t head = 0; head < queue.size(); ++head) {
+                uint32_t v = queue[head];
+                for (uint32_t e : out[v]) {
+                    if (edges[e].capacity > 0 && level[edges[e].to] < 0) {
+                        level[edges[e].to] = level[v] + 1;
+                        queue.push_back(edges[e].to);
+                    }
+                }
+            }
+            return level[sink] >= 0;
+        }
+
+        int64_t push(uint32_t v, uint32_t sink, int64_t limit) {
+            if (v == sink) return limit;
+            for (; next[v] < out[v].size(); ++next[v]) {
+                uint32_t e = out[v][next[v]];
+                Edge& edge = edges[e];
+                if (edge.capacity <= 0 || level[edge.to] != level[v] + 1) continue;
+                if (int64_t pushed = push(edge.to, sink, min(limit, edge.capacity))) {
+                    edge.capacity -= pushed;
+                    edges[e ^ 1].capacity += pushed;
+                    return pushed;
+                }
+            }
+            return 0;
+        }
+    };
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr char SEEN = 1, STUCK = 2;  // zoneMarks
+    static constexpr size_t FEW_ADDED = 64;      // past this, one max-flow beats a search per soldier
+
+    // Soldiers of one class in one state (WAITING or a warzone slot)
+    struct Group {
+        uint32_t cls, state;
+        vector<SoldierHandle> soldiers;
+    };
+
+    vector<Zone> zones;
+    vector<uint32_t> loads;     // soldiers deployed, per warzone slot
+    vector<uint32_t> states;    // per soldier: OFF, WAITING or a warzone slot
+    size_t waiting = 0;
+    Moves* log = nullptr;       // receives moves during a planning call
+    vector<uint32_t> changedZones;  // warzones rebalance() must check, since setZone() or setState()
+
+    // Planning state, rebuilt by refresh() after raw changes (dirty)
+    bool dirty = true;
+    unordered_map<string, uint32_t> classIds;  // access level + sorted skills -> class
+    vector<AccessLevel> classAccess;
+    vector<SkillList> classSkills;
+    vector<Bitmap> classZones;                 // per class: warzones it qualifies for
+    vector<Group> groups;
+    unordered_map<uint64_t, uint32_t> groupIds;  // class << 32 | warzone slot -> group
+    vector<uint32_t> waitingGroups;              // per class
+    vector<vector<uint32_t>> zoneGroups;         // per warzone slot: groups deployed there, some empty
+    vector<uint32_t> classOf, groupOf, position;  // per soldier: class, group, index in the group
+
+    // augment() scratch, per warzone slot and per class
+    vector<char> zoneMarks;
+    vector<uint32_t> fromSlot, viaGroup, queue;
+    vector<uint32_t> expandedIn;
+    uint32_t search = 0;
+
+    size_t classCount() const { return classAccess.size(); }
+    bool qualified(uint32_t c, uint32_t slot) const { return classZones[c].test(slot); }
+
+    void ensure(SoldierHandle h) {
+        if (h < states.size()) return;
+        states.resize(h + 1, OFF);
+        classOf.resize(h + 1, 0);
+        groupOf.resize(h + 1, 0);
+        position.resize(h + 1, 0);
+    }
+
+    void assignState(SoldierHandle h, uint32_t to) {
+        uint32_t from = states[h];
+        if (from == WAITING) --waiting;
+        else if (from != OFF) --loads[from];
+        if (to == WAITING) ++waiting;
+        else if (to != OFF) ++loads[to];
+        states[h] = to;
+        if (log) log->emplace_back(h, to);
+    }
+
+    // The class's warzones are left empty; callers fill them in with computeZones()
+    uint32_t internClass(AccessLevel access, SkillList& skills) {
+        sort(skills.begin(), skills.end());
+        skills.erase(unique(skills.begin(), skills.end()), skills.end());
+        string key(1, static_cast<char>(access));
+        key.append(reinterpret_cast<const char*>(skills.data()), skills.size() * sizeof(SkillId));
+        auto it = classIds.find(key);
+        if (it != classIds.end()) return it->second;
+        uint32_t c = static_cast<uint32_t>(classCount());
+        classIds.emplace(move(key), c);
+        classAccess.push_back(access);
+        classSkills.push_back(skills);
+        classZones.emplace_back();
+        waitingGroups.push_back(static_cast<uint32_t>(groups.size()));
+        groups.push_back({ c, WAITING, {} });
+        return c;
+    }
+
+    void computeZones(uint32_t c) {
+        for (uint32_t z = 0; z < zones.size(); ++z) {
+            if (qualifies(classAccess[c], classSkills[c], zones[z])) classZones[c].set(z);
+        }
+    }
+
+    void classify(SoldierHandle h, const SoldierStore& store) {
+        SkillList skills;
+        store.copySkills(h, skills);
+        size_t known = classCount();
+        classOf[h] = internClass(store.accessLevel(h), skills);
+        if (classCount() > known) computeZones(classOf[h]);
+    }
+
+    uint32_t groupFor(uint32_t c, uint32_t state) {
+        if (state == WAITING) return waitingGroups[c];
+        auto [it, added] = groupIds.emplace(uint64_t(c) << 32 | state, static_cast<uint32_t>(groups.size()));
+        if (added) {
+            groups.push_back({ c, state, {} });
+            zoneGroups[state].push_back(it->second);
+        }
+        return it->second;
+    }
+
+    void join(SoldierHandle h) {
+        groupOf[h] = groupFor(classOf[h], states[h]);
+        vector<SoldierHandle>& list = groups[groupOf[h]].soldiers;
+        position[h] = static_cast<uint32_t>(list.size());
+        list.push_back(h);
+    }
+
+    void leave(SoldierHandle h) {
+        vector<SoldierHandle>& list = groups[groupOf[h]].soldiers;
+        SoldierHandle last = list.back();
+        list[position[h]] = last;
+        position[last] = position[h];
+        list.pop_back();
+    }
+
+    void relocate(SoldierHandle h, uint32_t to) {
+        if (states[h] != OFF) leave(h);
+        assignState(h, to);
+        if (to != OFF) join(h);
+    }
+
+    // Rebuilds the classes from every pool soldier. Skills are gathered on this thread
+    // (snapshot soldiers intern their skill names); the qualification scan runs
+    // work-stealing over the classes.
+    void refresh(const SoldierStore& store) {
+        classIds.clear();
+        classAccess.clear();
+        classSkills.clear();
+        classZones.clear();
+        groups.clear();
+        groupIds.clear();
+        waitingGroups.clear();
+        zoneGroups.assign(zones.size(), {});
+        SkillList skills;
+        for (SoldierHandle h = 0; h < states.size(); ++h) {
+            if (states[h] == OFF) continue;
+            store.copySkills(h, skills);
+            classOf[h] = internClass(store.accessLevel(h), skills);
+        }
+        parallelForStealing(classCount(), 64, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) computeZones(static_cast<uint32_t>(c));
+        });
+        for (SoldierHandle h = 0; h < states.size(); ++h) {
+            if (states[h] != OFF) join(h);
+        }
+        dirty = false;
+    }
+
+    bool overCapacity(uint32_t slot) const { return zones[slot].capacity != 0 && loads[slot] > zones[slot].capacity; }
+
+    void evict(uint32_t slot) {
+        for (uint32_t g : zoneGroups[slot]) {
+            if (qualified(groups[g].cls, slot)) continue;
+            while (!groups[g].soldiers.empty()) relocate(groups[g].soldiers.back(), WAITING);
+        }
+        for (size_t i = 0; i < zoneGroups[slot].size() && overCapacity(slot); ++i) {
+            uint32_t g = zoneGroups[slot][i];
+            while (overCapacity(slot) && !groups[g].soldiers.empty()) relocate(groups[g].soldiers.back(), WAITING);
+        }
+    }
+
+    // A search that finds no room marks every warzone it reached as stuck. Placing a
+    // soldier only changes which classes sit in warzones along its chain, all of which
+    // lead to room, so a stuck warzone stays stuck for the rest of the call and later
+    // searches skip it.
+    void placeWaiting() {
+        bool room = false;
+        for (uint32_t z = 0; z < zones.size() && !room; ++z) room = hasRoom(z);
+        if (!room || waiting == 0) return;
+        zoneMarks.assign(zones.size(), 0);
+        fromSlot.resize(zones.size());
+        viaGroup.resize(zones.size());
+        expandedIn.resize(classCount(), 0);
+        for (uint32_t c = 0; c < classCount(); ++c) {
+            while (!groups[waitingGroups[c]].soldiers.empty() && augment(c)) {}
+        }
+    }
+
+    // Deploys one waiting soldier of class c. Breadth-first over warzones: a full warzone
+    // leads on to the warzones its deployed classes also qualify for, and the first one
+    // with room ends the search, so the chain of moves is as short as possible. Each class
+    // is followed once per search, from the first warzone it is found in.
+    bool augment(uint32_t c) {
+        if (++search == 0) {
+            fill(expandedIn.begin(), expandedIn.end(), 0);
+            search = 1;
+        }
+        queue.clear();
+        auto reach = [&](uint32_t z, uint32_t from, uint32_t via) {
+            if (zoneMarks[z]) return;
+            zoneMarks[z] = SEEN;
+            fromSlot[z] = from;
+            viaGroup[z] = via;
+            queue.push_back(z);
+        };
+        expandedIn[c] = search;
+        classZones[c].forEach([&](size_t z) { reach(static_cast<uint32_t>(z), NONE, NONE); });
+        uint32_t found = NONE;
+        for (size_t head = 0; head < queue.size(); ++head) {
+            uint32_t z = queue[head];
+            if (hasRoom(z)) {
+                found = z;
+                break;
+            }
+            for (uint32_t g : zoneGroups[z]) {
+                const Group& group = groups[g];
+                if (group.soldiers.empty() || expandedIn[group.cls] == search) continue;
+                expandedIn[group.cls] = search;
+                classZones[group.cls].forEach([&](size_t next) { reach(static_cast<uint32_t>(next), z, g); });
+            }
+        }
+        for (uint32_t z : queue) zoneMarks[z] = (found == NONE) ? STUCK : 0;
+        if (found == NONE) return false;
+
+        // Walk back from the warzone with room, moving one soldier forward per hop
+        uint32_t z = found;
+        for (; fromSlot[z] != NONE; z = fromSlot[z]) relocate(groups[viaGroup[z]].soldiers.back(), z);
+        relocate(groups[waitingGroups[c]].soldiers.back(), z);
+        return true;
+    }
+};
+
+// ------------------- WarzoneMap -------------------
+// Spatial index of warzone positions for nearest and within-radius queries. Positions
+// are kept as points on the unit sphere, where straight-line (chord) distance orders
+// points the same way as great-circle distance, so a 3-d k-d tree answers both queries
+// with no special cases at the poles or the date line. Each required access level has
+// its own tree, and a query searches only the levels the soldier is cleared for. Trees
+// are implicit (the median of every range sits in its middle) and rebuilt on demand:
+// newly placed zones wait in a short list that queries scan directly, and moved or
+// replaced zones leave dead tree entries behind, until either list grows too long.
+class WarzoneMap {
+public:
+    static constexpr double EARTH_RADIUS_KM = 6371.0;
+    static constexpr double PI = 3.14159265358979323846;
+
+    struct Hit {
+        uint32_t slot;
+        double km;
+    };
+
+    static bool validPosition(double latitude, double longitude) {
+        return latitude >= -90 && latitude <= 90 && longitude >= -180 && longitude <= 180;  // false for NaN
+    }
+
+    // Great-circle distance, haversine formula
+    static double distanceKm(double lat1, double lon1, double lat2, double lon2) {
+        const double toRadians = PI / 180;
+        double dLat = (lat2 - lat1) * toRadians, dLon = (lon2 - lon1) * toRadians;
+        double a = sin(dLat / 2) * sin(dLat / 2) + cos(lat1 * toRadians) * cos(lat2 * toRadians) * sin(dLon / 2) * sin(dLon / 2);
+        return 2 * EARTH_RADIUS_KM * asin(min(1.0, sqrt(a)));
+    }
+
+    void clear() {
+        positions.clear();
+        for (vector<Point>& tree : trees) tree.clear();
+        pending.clear();
+        dead = 0;
+    }
+
+    // Puts a warzone on the map, or takes it off if the position is not valid
+    void set(uint32_t slot, AccessLevel access, double latitude, double longitude) {
+        if (slot >= positions.size()) positions.resize(slot + 1);
+        Position& p = positions[slot];
+        if (p.inTree) {
+            p.inTree = false;
+            ++dead;
+        }
+        p.latitude = latitude;
+        p.longitude = longitude;
+        p.level = validPosition(latitude, longitude) ? static_cast<int8_t>(static_cast<int>(access) - 1) : -1;
+        if (p.level < 0) return;
+        p.point = toPoint(latitude, longitude, slot);
+        if (!p.pending) {
+            p.pending = true;
+            pending.push_back(slot);
+        }
+    }
+
+    // Up to k warzones closest to the position that the clearance allows, nearest first,
+    // optionally only those within maxKm
+    vector<Hit> nearest(double latitude, double longitude, AccessLevel clearance, size_t k, double maxKm = INFINITY) {
+        vector<Hit> hits;
+        if (k == 0 || !validPosition(latitude, longitude) || !(maxKm >= 0)) return hits;
+        if (pending.size() > REBUILD_PENDING || dead > treeSize / 4) rebuild();
+
+        // Search bound as a squared chord, a little generous against float rounding;
+        // exact distances are checked at the end
+        Query q;
+        q.target = toPoint(latitude, longitude, 0);
+        q.k = k;
+        q.heap.reserve(min<size_t>(k + 1, 64));
+        if (maxKm < PI * EARTH_RADIUS_KM) {
+            double chord = 2 * sin(maxKm / (2 * EARTH_RADIUS_KM));
+            q.bound = static_cast<float>(chord * chord * (1 + 1e-5) + 1e-9);
+        }
+        int levels = static_cast<int>(clearance);
+        for (int level = 0; level < levels; ++level) search(trees[level], 0, trees[level].size(), 0, q);
+        for (uint32_t slot : pending) {
+            const Position& p = positions[slot];
+            if (p.pending && p.level >= 0 && p.level < levels) q.offer(squaredChord(p.point, q.target), slot);
+        }
+
+        hits.reserve(q.heap.size());
+        for (const auto& candidate : q.heap) {
+            const Position& p = positions[candidate.second];
+            double km = distanceKm(latitude, longitude, p.latitude, p.longitude);
+            if (km <= maxKm) hits.push_back({ candidate.second, km });
+        }
+        sort(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) { return a.km < b.km || (a.km == b.km && a.slot < b.slot); });
+        return hits;
+    }
+
+private:
+    static const size_t REBUILD_PENDING = 512;  // unindexed zones a query scans before the trees are rebuilt
+
+    struct Point {
+        float axis[3];
+        uint32_t slot;
+    };
+
+    struct Position {
+        double latitude = NAN, longitude = NAN;
+        Point point{};
+        int8_t level = -1;    // required access level - 1, -1 = not on the map
+        bool inTree = false;  // the trees hold this position
+        bool pending = false; // queued in 'pending' instead
+    };
+
+    struct Query {
+        Point target;
+        size_t k = 0;
+        float bound = 4.01f;                 // squared chord; a full sphere is 4
+        vector<pair<float, uint32_t>> heap;  // best candidates so far, farthest on top
+
+        void offer(float d2, uint32_t slot) {
+            if (d2 > bound) return;
+            heap.emplace_back(d2, slot);
+            push_heap(heap.begin(), heap.end());
+            if (heap.size() > k) {
+                pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+            if (heap.size() == k) bound = heap.front().first;
+        }
+    };
+
+    vector<Position> positions;  // by warzone slot
+    vector<Point> trees[ACCESS_LEVEL_COUNT];
+    size_t treeSize = 0;
+    vector<uint32_t> pending;
+    size_t dead = 0;
+
+    static Point toPoint(double latitude, double longitude, uint32_t slot) {
+        const double toRadians = PI / 180;
+        double lat = latitude * toRadians, lon = longitude * toRadians;
+        return { { static_cast<float>(cos(lat) * cos(lon)), static_cast<float>(cos(lat) * sin(lon)), static_cast<float>(sin(lat)) }, slot };
+    }
+
+    static float squaredChord(const Point& a, const Point& b) {
+        float dx = a.axis[0] - b.axis[0], dy = a.axis[1] - b.axis[1], dz = a.axis[2] - b.axis[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    void rebuild() {
+        treeSize = 0;
+        for (vector<Point>& tree : trees) tree.clear();
+        for (Position& p : positions) {
+            p.pending = false;
+            p.inTree = p.level >= 0;
+            if (p.inTree) {
+                trees[p.level].push_back(p.point);
+                ++treeSize;
+            }
+        }
+        for (vector<Point>& tree : trees) build(tree, 0, tree.size(), 0);
+        pending.clear();
+        dead = 0;
+    }
+
+    static void build(vector<Point>& tree, size_t lo, size_t hi, int axis) {
+        if (hi - lo <= 1) return;
+        size_t mid = lo + (hi - lo) / 2;
+        nth_element(tree.begin() + lo, tree.begin() + mid, tree.begin() + hi,
+                    [axis](const Point& a, const Point& b) { return a.axis[axis] < b.axis[axis]; });
+        build(tree, lo, mid, (axis + 1) % 3);
+        build(tree, mid + 1, hi, (axis + 1) % 3);
+    }
+
+    // Near side first, the far side only if the splitting plane is within the bound
+    void search(const vector<Point>& tree, size_t lo, size_t hi, int axis, Query& q) const {
+        if (lo >= hi) return;
+        size_t mid = lo + (hi - lo) / 2;
+        const Point& p = tree[mid];
+        if (positions[p.slot].inTree) q.offer(squaredChord(p, q.target), p.slot);
+        float diff = q.target.axis[axis] - p.axis[axis];
+        int next = (axis + 1) % 3;
+        if (diff < 0) {
+            search(tree, lo, mid, next, q);
+            if (diff * diff <= q.bound) search(tree, mid + 1, hi, next, q);
+        } else {
+            search(tree, mid + 1, hi, next, q);
+            if (diff * diff <= q.bound) search(tree, lo, mid, next, q);
+        }
+    }
+};
+
+// ------------------- LatencyHistogram -------------------
+// Log-linear latency histogram in nanoseconds: 16 sub-buckets per power of two, so
+// any recorded value is off by at most 1/16 (~6%). Recording is a couple of relaxed
+// atomic adds, cheap enough to leave on for every command.
+class LatencyHistogram {
+private:
+    static const int SUB_BITS = 4;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int BUCKET_COUNT = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+    atomic<uint64_t> buckets[BUCKET_COUNT] = {};
+    atomic<uint64_t> total{0}, errors{0}, sumNs{0}, maxNs{0};
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < SUB_COUNT) return static_cast<int>(ns);
+        int shift = 63 - __builtin_clzll(ns) - SUB_BITS;
+        return (shift + 1) * SUB_COUNT + static_cast<int>((ns >> shift) & (SUB_COUNT - 1));
+    }
+
+    // Midpoint of the values that fall into a bucket
+    static uint64_t valueOf(int bucket) {
+        if (bucket < SUB_COUNT) return static_cast<uint64_t>(bucket);
+        int shift = bucket / SUB_COUNT - 1;
+        uint64_t low = static_cast<uint64_t>(SUB_COUNT + bucket % SUB_COUNT) << shift;
+        return low + ((uint64_t(1) << shift) >> 1);
+    }
+
+public:
+    void record(uint64_t ns, bool ok) {
+        buckets[bucketOf(ns)].fetch_add(1, memory_order_relaxed);
+        total.fetch_add(1, memory_order_relaxed);
+        if (!ok) errors.fetch_add(1, memory_order_relaxed);
+        sumNs.fetch_add(ns, memory_order_relaxed);
+        uint64_t seen = maxNs.load(memory_order_relaxed);
+        while (ns > seen && !maxNs.compare_exchange_weak(seen, ns, memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const { return total.load(memory_order_relaxed); }
+    uint64_t errorCount() const { return errors.load(memory_order_relaxed); }
+    uint64_t max() const { return maxNs.load(memory_order_relaxed); }
+    uint64_t mean() const { uint64_t n = count(); return n ? sumNs.load(memory_order_relaxed) / n : 0; }
+
+    // Latency below which a fraction q (0..1) of the recorded commands fall
+    uint64_t percentile(double q) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(n - 1)) + 1, seen = 0;
+        for (int b = 0; b < BUCKET_COUNT; ++b) {
+            seen += buckets[b].load(memory_order_relaxed);
+            if (seen >= rank) return min(valueOf(b), max());
+        }
+        return max();
+    }
+};
+
+// Forwards reads to another stream buffer and adds up the time spent blocked in it, so
+// interactive command timings can leave out the time the user spends typing arguments.
+// Hands out one character at a time, which is plenty for console input.
+class InputClock : public streambuf {
+private:
+    streambuf* source;
+    char current = 0;
+    uint64_t waitedNs = 0;
+
+protected:
+    int_type underflow() override {
+        auto start = chrono::steady_clock::now();
+        int_type c = source->sbumpc();
+        waitedNs += static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        if (traits_type::eq_int_type(c, traits_type::eof())) return c;
+        current = traits_type::to_char_type(c);
+        setg(&current, &current, &current + 1);
+        return c;
+    }
+
+public:
+    explicit InputClock(streambuf* source) : source(source) {}
+    uint64_t waited() const { return waitedNs; }
+};
+
+// ------------------- CommandTable -------------------
+// Command name -> handler table with open addressing. The built-in commands are hashed
+// with a seed chosen at compile time so that each lands in its own slot (a perfect hash,
+// checked by static_assert), making their lookup one hash and one compare no matter how
+// many commands exist. Commands registered later by other subsystems share the table
+// and fall back to linear probing; the table is kept at most half full.
+constexpr uint32_t commandHash(string_view name, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;  // FNV-1a
+    for (char c : name) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+class CommandTable {
+public:
+    static const size_t CAPACITY = 128;  // power of two
+
+    struct Entry {
+        string name;
+        string help;
+        function<bool()> handler;
+        LatencyHistogram latency;
+        uint8_t index;  // registration order, see all()
+    };
+
+    explicit CommandTable(uint32_t s) : seed(s) {}
+
+    // Returns false if the name is taken or the table is half full
+    bool add(const string& name, const string& help, function<bool()> handler) {
+        if (find(name) || entries.size() >= CAPACITY / 2) return false;
+        entries.emplace_back();
+        Entry& entry = entries.back();
+        entry.name = name;
+        entry.help = help;
+        entry.handler = move(handler);
+        entry.index = static_cast<uint8_t>(entries.size() - 1);
+        size_t slot = commandHash(name, seed) & (CAPACITY - 1);
+        while (slots[slot]) slot = (slot + 1) & (CAPACITY - 1);
+        slots[slot] = &entry;
+        return true;
+    }
+
+    Entry* find(string_view name) {
+        for (size_t slot = commandHash(name, seed) & (CAPACITY - 1); slots[slot]; slot = (slot + 1) & (CAPACITY - 1)) {
+            if (slots[slot]->name == name) return slots[slot];
+        }
+        return nullptr;
+    }
+
+    // Entries in registration order (for help and stats)
+    const deque<Entry>& all() const { return entries; }
+
+private:
+    uint32_t seed;
+    Entry* slots[CAPACITY] = {};
+    deque<Entry> entries;  // stable addresses
+};
+
+// Smallest seed under which every name gets a distinct slot, or UINT32_MAX if none is found
+template <typename Spec, size_t N>
+constexpr uint32_t findPerfectSeed(const Spec (&specs)[N]) {
+    static_assert(N <= CommandTable::CAPACITY / 2, "too many built-in commands for the table");
+    for (uint32_t seed = 0; seed < 10000; ++seed) {
+        bool used[CommandTable::CAPACITY] = {};
+        bool collision = false;
+        for (size_t i = 0; i < N && !collision; ++i) {
+            size_t slot = commandHash(specs[i].name, seed) & (CommandTable::CAPACITY - 1);
+            collision = used[slot];
+            used[slot] = true;
+        }
+        if (!collision) return seed;
+    }
+    return UINT32_MAX;
+}
+
+// ------------------- Bulk import -------------------
+// Reads soldiers, weapons and warzones from CSV or JSON-lines files, one record per line:
+//   soldier,<id>,<first_name>,<last_name>,<rank>,<rank_level>,<access>,<branch>,<specialization>,<experience>[,<skills>]
+//   weapon,<name>,<type>,<damage>,<range>,<accuracy>,<access>[,<quantity>]
+//   warzone,<id>,<name>,<location>,<description>,<access>[,<latitude>,<longitude>]
+// or {"kind":"soldier","id":"S1",...} with the same field names. Access levels are 1-4
+// or their names, branches 1-6 or their names, skills are separated by ';'. CSV fields
+// may be double-quoted but cannot span lines. Lines starting with '#' are skipped.
+const size_t IMPORT_CHUNK_SIZE = 1 << 20;  // bytes of input per parse task
+const size_t IMPORT_MAX_ERRORS_SHOWN = 20;
+
+enum ImportKindId { IMPORT_SOLDIER, IMPORT_WEAPON, IMPORT_WARZONE, IMPORT_KIND_COUNT };
+
+struct ImportKind {
+    const char* name;
+    const char* const* columns;
+    size_t columnCount;
+    size_t required;  // leading columns that must be present
+};
+
+const char* const SOLDIER_COLUMNS[] = { "id", "first_name", "last_name", "rank", "rank_level", "access",
+                                        "branch", "specialization", "experience", "skills" };
+const char* const WEAPON_COLUMNS[] = { "name", "type", "damage", "range", "accuracy", "access", "quantity" };
+const char* const WARZONE_COLUMNS[] = { "id", "name", "location", "description", "access", "latitude", "longitude" };
+
+const ImportKind IMPORT_KINDS[IMPORT_KIND_COUNT] = {
+    { "soldier", SOLDIER_COLUMNS, 10, 9 },
+    { "weapon", WEAPON_COLUMNS, 7, 6 },
+    { "warzone", WARZONE_COLUMNS, 7, 5 },
+};
+
+inline bool parseInt(string_view text, int& value) {
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    return ec == errc() && end == text.data() + text.size() && !text.empty();
+}
+
+inline bool parseDouble(string_view text, double& value) {
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    return ec == errc() && end == text.data() + text.size() && !text.empty();
+}
+
+// "<latitude>,<longitude>" in degrees
+bool parsePosition(string_view text, double& latitude, double& longitude) {
+    size_t comma = text.find(',');
+    return comma != string_view::npos && parseDouble(text.substr(0, comma), latitude) &&
+           parseDouble(text.substr(comma + 1), longitude) && WarzoneMap::validPosition(latitude, longitude);
+}
+
+// Accepts 1-4 or CONFIDENTIAL/SECRET/TOP_SECRET/SCI
+bool parseAccessLevel(string_view text, AccessLevel& level) {
+    static const char* names[] = { "CONFIDENTIAL", "SECRET", "TOP_SECRET", "SCI" };
+    int value = 0;
+    for (int i = 0; i < ACCESS_LEVEL_COUNT; ++i) {
+        if (text == names[i]) value = i + 1;
+    }
+    if (!value && !parseInt(text, value)) return false;
+    if (!isValidAccessLevel(value)) return false;
+    level = static_cast<AccessLevel>(value);
+    return true;
+}
+
+// Accepts 1-6 (as in the create_soldier prompt) or the branch name
+bool parseBranch(string_view text, MilitaryBranch& branch) {
+    static const char* names[] = { "ARMY", "NAVY", "AIR_FORCE", "MARINES", "COAST_GUARD", "SPACE_FORCE" };
+    int value = 0;
+    for (int i = 0; i < BRANCH_COUNT; ++i) {
+        if (text == names[i]) value = i + 1;
+    }
+    if (!value && !parseInt(text, value)) return false;
+    if (value < 1 || value > BRANCH_COUNT) return false;
+    branch = static_cast<MilitaryBranch>(value - 1);
+    return true;
+}
+
+// Splits one CSV line into fields, undoing "..." quoting with "" escapes
+bool splitCsvLine(string_view line, vector<string>& fields, size_t& count) {
+    count = 0;
+    size_t i = 0;
+    while (true) {
+        if (count == fields.size()) fields.emplace_back();
+        string& field = fields[count++];
+        field.clear();
+        if (i < line.size() && line[i] == '"') {
+            for (++i;; ++i) {
+                if (i >= line.size()) return false;  // unterminated quote
+                if (line[i] == '"') {
+                    if (i + 1 < line.size() && line[i + 1] == '"') {
+                        field += '"';
+                        ++i;
+                    } else {
+                        ++i;
+                        break;
+                    }
+                } else {
+                    field += line[i];
+                }
+            }
+            if (i < line.size() && line[i] != ',') return false;
+        } else {
+            size_t comma = line.find(',', i);
+            field.assign(line.substr(i, comma == string_view::npos ? string_view::npos : comma - i));
+            i = (comma == string_view::npos) ? line.size() : comma;
+        }
+        if (i >= line.size()) return true;
+        ++i;  // skip the comma
+    }
+}
+
+// Parses one flat JSON object whose values are strings, numbers or booleans
+bool parseJsonObject(string_view line, vector<pair<string, string>>& members) {
+    members.clear();
+    size_t i = 0;
+    auto skipSpace = [&] { while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) ++i; };
+    auto parseString = [&](string& out) {
+        out.clear();
+        if (i >= line.size() || line[i] != '"') return false;
+        for (++i; i < line.size(); ++i) {
+            char c = line[i];
+            if (c == '"') {
+                ++i;
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (++i >= line.size()) return false;
+            switch (line[i]) {
+            case '"': case '\\': case '/': out += line[i]; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned code = 0;
+                if (i + 4 >= line.size() || from_chars(line.data() + i + 1, line.data() + i + 5, code, 16).ptr != line.data() + i + 5) return false;
+                i += 4;
+                if (code < 0x80) {
+                    out += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    out += static_cast<char>(0xC0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    out += static_cast<char>(0xE0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: return false;
+            }
+        }
+        return false;
+    };
+
+    skipSpace();
+    if (i >= line.size() || line[i++] != '{') return false;
+    skipSpace();
+    if (i < line.size() && line[i] == '}') return true;
+    while (true) {
+        members.emplace_back();
+        skipSpace();
+        if (!parseString(members.back().first)) return false;
+        skipSpace();
+        if (i >= line.size() || line[i++] != ':') return false;
+        skipSpace();
+        if (i < line.size() && line[i] == '"') {
+            if (!parseString(members.back().second)) return false;
+        } else {
+            size_t start = i;
+            while (i < line.size() && line[i] != ',' && line[i] != '}' && line[i] != ' ' && line[i] != '\t') ++i;
+            members.back().second.assign(line.substr(start, i - start));
+            if (members.back().second.empty() || members.back().second == "null") return false;
+        }
+        skipSpace();
+        if (i >= line.size()) return false;
+        if (line[i] == '}') break;
+        if (line[i++] != ',') return false;
+    }
+    ++i;
+    skipSpace();
+    return i == line.size();
+}
+
+struct ImportedWeapon {
+    Weapon weapon;
+    int quantity;
+};
+
+// Parsed and validated records of one chunk, in file order per kind
+struct ImportChunk {
+    vector<Soldier> soldiers;
+    vector<ImportedWeapon> weapons;
+    vector<Warzone> warzones;
+    vector<pair<size_t, string>> errors;  // line within the chunk (1-based), message
+    size_t lines = 0;
+};
+
+// Validates one record (values in column order, missing optional ones empty) and adds
+// it to the chunk. Returns an error message, or "" if the record was accepted.
+string buildImportRecord(ImportKindId kind, const string* values, ImportChunk& chunk) {
+    int rankLevel = 0, experience = 0, damage = 0, range = 0, accuracy = 0, quantity = 0;
+    AccessLevel access = AccessLevel::CONFIDENTIAL;
+    MilitaryBranch branch = MilitaryBranch::ARMY;
+    switch (kind) {
+    case IMPORT_SOLDIER: {
+        if (values[0].empty() || values[1].empty() || values[2].empty() || values[3].empty()) return "missing id, name or rank";
+        if (!parseInt(values[4], rankLevel) || !isValidRankLevel(rankLevel)) return "invalid rank level: " + values[4];
+        if (!parseAccessLevel(values[5], access)) return "invalid access level: " + values[5];
+        if (!parseBranch(values[6], branch)) return "invalid branch: " + values[6];
+        if (!parseInt(values[8], experience) || experience < 0) return "invalid experience: " + values[8];
+        MilitaryRank rank(values[3], rankLevel, access, branch);
+        chunk.soldiers.emplace_back(values[0], values[1], values[2], rank,
+                                    values[7].empty() ? string("Infantry") : values[7], experience);
+        string_view skills = values[9];
+        while (!skills.empty()) {
+            size_t end = skills.find(';');
+            string_view skill = skills.substr(0, end);
+            if (!skill.empty()) chunk.soldiers.back().addSkill(skill);
+            skills = (end == string_view::npos) ? string_view() : skills.substr(end + 1);
+        }
+        return "";
+    }
+    case IMPORT_WEAPON:
+        if (values[0].empty() || values[1].empty()) return "missing weapon name or type";
+        if (!parseInt(values[2], damage) || damage < 0) return "invalid damage rating: " + values[2];
+        if (!parseInt(values[3], range) || range < 0) return "invalid range: " + values[3];
+        if (!parseInt(values[4], accuracy) || accuracy < 0 || accuracy > 100) return "invalid accuracy: " + values[4];
+        if (!parseAccessLevel(values[5], access)) return "invalid access level: " + values[5];
+        if (!values[6].empty() && (!parseInt(values[6], quantity) || quantity < 0)) return "invalid quantity: " + values[6];
+        chunk.weapons.push_back({ Weapon(values[0], values[1], damage, range, accuracy, access), quantity });
+        return "";
+    case IMPORT_WARZONE:
+        if (values[0].empty() || values[1].empty()) return "missing warzone id or name";
+        if (!parseAccessLevel(values[4], access)) return "invalid access level: " + values[4];
+        chunk.warzones.emplace_back(values[0], values[1], values[2], values[3], access);
+        if (!values[5].empty() || !values[6].empty()) {
+            double latitude = 0, longitude = 0;
+            if (!parseDouble(values[5], latitude) || !parseDouble(values[6], longitude) ||
+                !WarzoneMap::validPosition(latitude, longitude)) {
+                chunk.warzones.pop_back();
+                return "invalid position: " + values[5] + "," + values[6];
+            }
+            chunk.warzones.back().setPosition(latitude, longitude);
+        }
+        return "";
+    default:
+        return "unknown record kind";
+    }
+}
+
+// Parses and validates a block of whole lines. Runs on a worker thread and touches no
+// shared state.
+ImportChunk parseImportChunk(string_view text, bool json) {
+    ImportChunk chunk;
+    vector<string> fields;                    // [0] = kind, then values in column order
+    vector<pair<string, string>> members;     // JSON key/value pairs
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t newline = text.find('\n', pos);
+        string_view line = text.substr(pos, newline == string_view::npos ? string_view::npos : newline - pos);
+        pos = (newline == string_view::npos) ? text.size() : newline + 1;
+        ++chunk.lines;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.find_first_not_of(" \t") == string_view::npos || line[0] == '#') continue;
+
+        string error;
+        int kind = -1;
+        if (!json) {
+            size_t count = 0;
+            if (!splitCsvLine(line, fields, count)) {
+                error = "malformed CSV line";
+            } else if (fields[0] == "kind") {
+                continue;  // header row
+            } else {
+                for (int k = 0; k < IMPORT_KIND_COUNT; ++k) {
+                    if (fields[0] == IMPORT_KINDS[k].name) kind = k;
+                }
+                if (kind < 0) {
+                    error = "unknown record kind: " + fields[0];
+                } else if (count - 1 < IMPORT_KINDS[kind].required || count - 1 > IMPORT_KINDS[kind].columnCount) {
+                    error = "wrong number of fields for " + fields[0];
+                } else {
+                    if (fields.size() <= IMPORT_KINDS[kind].columnCount) fields.resize(IMPORT_KINDS[kind].columnCount + 1);
+                    for (size_t c = count; c <= IMPORT_KINDS[kind].columnCount; ++c) fields[c].clear();
+                }
+            }
+        } else if (!parseJsonObject(line, members)) {
+            error = "malformed JSON object";
+        } else {
+            for (const auto& [key, value] : members) {
+                if (key != "kind") continue;
+                for (int k = 0; k < IMPORT_KIND_COUNT; ++k) {
+                    if (value == IMPORT_KINDS[k].name) kind = k;
+                }
+                if (kind < 0) error = "unknown record kind: " + value;
+            }
+            if (kind < 0 && error.empty()) error = "missing \"kind\"";
+            if (kind >= 0) {
+                const ImportKind& spec = IMPORT_KINDS[kind];
+                if (fields.size() <= spec.columnCount) fields.resize(spec.columnCount + 1);
+                uint32_t present = 0;
+                for (auto& [key, value] : members) {
+                    if (key == "kind") continue;
+                    size_t c = 0;
+                    while (c < spec.columnCount && key != spec.columns[c]) ++c;
+                    if (c == spec.columnCount) {
+                        error = "unknown field for " + string(spec.name) + ": " + key;
+                        break;
+                    }
+                    fields[c + 1] = move(value);
+                    present |= 1u << c;
+                }
+                for (size_t c = 0; c < spec.columnCount && error.empty(); ++c) {
+                    if (present & (1u << c)) continue;
+                    if (c < spec.required) error = "missing field \"" + string(spec.columns[c]) + "\"";
+                    fields[c + 1].clear();
+                }
+            }
+        }
+        if (error.empty()) error = buildImportRecord(static_cast<ImportKindId>(kind), fields.data() + 1, chunk);
+        if (!error.empty()) chunk.errors.emplace_back(chunk.lines, move(error));
+    }
+    return chunk;
+}
+
+// ------------------- Session -------------------
+// Login state of one operator: the console, a batch run or a server client. A session
+// is passive data that a command runs against, so there is no thread or stack per
+// operator; the server resumes a client's session whenever a request arrives. It holds
+// the soldier's handle and clearance (checked against the store's counters instead of
+// being looked up on every command) and a ring of recent commands, and is small
+// enough (about 150 bytes) to keep millions of idle ones around.
+class Session {
+public:
+    static const size_t HISTORY_SIZE = 16;
+
+    struct HistoryEntry {
+        uint32_t time;    // seconds since the epoch
+        uint8_t command;  // CommandTable::Entry::index
+        bool ok;
+    };
+
+    SoldierHandle user = SoldierStore::npos;
+    AccessLevel clearance = AccessLevel::CONFIDENTIAL;
+    uint32_t generation = 0;    // SoldierStore::generation() at login
+    uint32_t replacements = 0;  // SoldierStore::replacements() when clearance was read
+
+    void record(uint8_t command, bool ok) {
+        history[historyNext] = { static_cast<uint32_t>(time(nullptr)), command, ok };
+        historyNext = static_cast<uint8_t>((historyNext + 1) % HISTORY_SIZE);
+        if (historyCount < HISTORY_SIZE) ++historyCount;
+    }
+
+    // Oldest first
+    template <typename Fn>
+    void forEachHistory(Fn fn) const {
+        for (size_t i = 0; i < historyCount; ++i) fn(history[(historyNext + HISTORY_SIZE - historyCount + i) % HISTORY_SIZE]);
+    }
+
+private:
+    HistoryEntry history[HISTORY_SIZE];
+    uint8_t historyNext = 0, historyCount = 0;
+};
+
+// ------------------- MilitaryManagementSystem -------------------
+class MilitaryManagementSystem {
+private:
+    SoldierStore soldiers;
+    WeaponCatalog weaponCatalog;
+    pmr::unsynchronized_pool_resource nodePool;  // map nodes, freed together with the system
+    ObjectPool<Warzone, 256> warzonePool;
+    vector<Warzone*> warzones;                   // dense warzone slots, objects owned by warzonePool
+    pmr::map<string, size_t> warzoneSlots{&nodePool};  // warzone ID -> slot
+    Session consoleSession;      // used by the console and batch runs
+    Session* session;            // session the running command belongs to
+    Inventory inventory;
+    AccessIndex accessIndex;
+    DeploymentScheduler deployments;
+    WarzoneMap warzoneMap;
+    unique_ptr<Journal> journal;  // null unless started with --journal
+    uint64_t journalEpoch = 0;    // bumped by every snapshot save
+    CommandTable commands;
+    LatencyHistogram unknownCommandLatency;
+    InputClock* inputClock = nullptr;  // console input while run() is active
+    string clientFileDir;              // where server clients' files go; empty refuses them
+    istream* in;        // where commands read their arguments from
+    bool interactive;   // prompts are only printed for a human at the console
+
+    void prompt(const char* text) const {
+        if (interactive) cout << text;
+    }
+    bool argumentsOk() const;
+    Soldier* currentUser();
+    bool inventoryCleared();
+    bool clearedFor(AccessLevel required, string_view resource);
+    bool servedLocally(const string& what);
+    bool clientFilePath(string& path);
+    bool collectTargets(const string& target, vector<SoldierHandle>& handles);
+    void storeWarzone(Warzone warzone);
+    void recordDeployments(const DeploymentScheduler::Moves& moves);
+    void rebalanceDeployments();
+
+public:
+    enum class AssignStatus { OK, NOT_FOUND, ACCESS_DENIED, MISSING_SKILLS, FULL };
+
+    // A built-in command; the list is fixed at compile time (see BUILTIN_COMMANDS)
+    struct CommandSpec {
+        const char* name;
+        const char* help;
+        bool (MilitaryManagementSystem::*handler)();
+    };
+
+    // Outcome of one script run through runBatch()
+    struct BatchResult {
+        size_t succeeded = 0;
+        size_t failed = 0;
+    };
+
+    // Outcome of importFile()
+    struct ImportResult {
+        bool opened = false;
+        size_t soldiers = 0, weapons = 0, warzones = 0;
+        size_t rejected = 0;  // lines that failed validation
+    };
+
+    MilitaryManagementSystem();
+    bool login(string soldierId);
+    void logout();
+    void run();
+    BatchResult runBatch(istream& script);
+    bool registerCommand(const string& name, const string& help, function<bool()> handler);
+    bool dispatch(const string& command);
+    bool showStats();
+    bool writeStats(const string& path) const;
+    bool showHelp();
+    void showRankInfo();
+    void showBranchInfo();
+    void showAccessLevelInfo();
+    MilitaryRank createRank();
+    Soldier* createSoldier();
+    SoldierHandle addSoldier(Soldier soldier);
+    bool addWeaponManually();
+    bool addWarzoneManually();
+    void addDefaultWeaponsAndWarzones();
+    WeaponId addWeaponType(const Weapon& weapon);
+    void addWarzone(Warzone warzone);
+    bool saveSnapshot(const string& path);
+    bool loadSnapshot(const string& path);
+    ImportResult importFile(const string& path);
+    bool openJournal(const string& path);
+    void applyJournalRecord(JournalOp op, JournalReader& record);
+    bool commitJournal();
+    bool syncJournal() { return !journal || journal->commitAll(); }  // commitJournal without the console warning
+    bool executeLine(const string& line, Session& client, string& output);
+    void setClientFileDir(const string& directory) { clientFileDir = directory; }
+    bool historyCommand();
+    AssignStatus assignWeapon(const string& soldierId, const string& weaponName);
+    AssignStatus assignWarzone(const string& soldierId, const string& warzoneId);
+    bool assignUnit(const string& soldierId, const string& unitName);
+    bool promote(const string& soldierId, const string& rankName, int rankLevel);
+    bool assignWeaponToSoldier();
+    bool assignWarzoneToSoldier();
+    bool displaySoldierInfo();
+    bool loginCommand();
+    bool logoutCommand();
+    bool createSoldierCommand();
+    bool viewInventory();
+    bool saveSnapshotCommand();
+    bool loadSnapshotCommand();
+    bool importCommand();
+    bool reportCommand();
+    bool findSoldiersCommand();
+    bool assignUnitCommand();
+    bool promoteCommand();
+    bool seniorityCommand();
+    bool optimizeLoadoutCommand();
+    bool addSupplyCommand();
+    bool issueCommand();
+    bool setWarzoneCommand();
+    bool deployCommand();
+    bool withdrawCommand();
+    bool deploymentsCommand();
+    bool nearbyWarzonesCommand();
+    bool auditCommand();
+};
+
+constexpr MilitaryManagementSystem::CommandSpec BUILTIN_COMMANDS[] = {
+    { "login", "Log in with Soldier ID", &MilitaryManagementSystem::loginCommand },
+    { "create_soldier", "Create a new soldier", &MilitaryManagementSystem::createSoldierCommand },
+    { "add_weapon", "Add a new weapon manually", &MilitaryManagementSystem::addWeaponManually },
+    { "add_warzone", "Add a new warzone manually", &MilitaryManagementSystem::addWarzoneManually },
+    { "assign_weapon", "Assign a weapon to the logged-in soldier", &MilitaryManagementSystem::assignWeaponToSoldier },
+    { "set_warzone", "Set a warzone's capacity, required skills and map position", &MilitaryManagementSystem::setWarzoneCommand },
+    { "assign_warzone", "Deploy a soldier to a warzone", &MilitaryManagementSystem::assignWarzoneToSoldier },
+    { "deploy", "Deploy a soldier, unit or the force to the warzones they qualify for", &MilitaryManagementSystem::deployCommand },
+    { "withdraw", "Withdraw a soldier from deployment", &MilitaryManagementSystem::withdrawCommand },
+    { "deployments", "Show warzone deployments, or the soldiers deployed to one warzone", &MilitaryManagementSystem::deploymentsCommand },
+    { "nearby_warzones", "Nearest accessible warzones to a position or warzone, or those within a radius", &MilitaryManagementSystem::nearbyWarzonesCommand },
+    { "assign_unit", "Assign a soldier to a unit", &MilitaryManagementSystem::assignUnitCommand },
+    { "promote", "Change a soldier's rank name and level", &MilitaryManagementSystem::promoteCommand },
+    { "add_supply", "Add supplies to the inventory", &MilitaryManagementSystem::addSupplyCommand },
+    { "issue", "Issue several weapons and supplies to a soldier at once, all or nothing", &MilitaryManagementSystem::issueCommand },
+    { "display_soldier", "Display the information of the logged-in soldier", &MilitaryManagementSystem::displaySoldierInfo },
+    { "view_inventory", "View current inventory status (based on access level)", &MilitaryManagementSystem::viewInventory },
+    { "save_snapshot", "Save the whole system to a snapshot file", &MilitaryManagementSystem::saveSnapshotCommand },
+    { "load_snapshot", "Replace the current state with a snapshot file", &MilitaryManagementSystem::loadSnapshotCommand },
+    { "find_soldiers", "Find soldiers by branch, access, rank, experience and specialization", &MilitaryManagementSystem::findSoldiersCommand },
+    { "seniority", "Top-k, n-th most senior or seniority rank within the force, a branch or a unit", &MilitaryManagementSystem::seniorityCommand },
+    { "optimize_loadout", "Suggest (or issue) the best loadouts from stock for a soldier, unit or the force", &MilitaryManagementSystem::optimizeLoadoutCommand },
+    { "report", "Write an inventory, roster or loadouts report to a file", &MilitaryManagementSystem::reportCommand },
+    { "import", "Bulk-load soldiers, weapons and warzones from a CSV or JSON-lines file", &MilitaryManagementSystem::importCommand },
+    { "history", "Show the commands recently run in this session", &MilitaryManagementSystem::historyCommand },
+    { "audit", "Search the access audit trail by soldier and time range", &MilitaryManagementSystem::auditCommand },
+    { "stats", "Show per-command latency statistics", &MilitaryManagementSystem::showStats },
+    { "logout", "Log out from the system", &MilitaryManagementSystem::logoutCommand },
+    { "help", "Show this list", &MilitaryManagementSystem::showHelp },
+};
+
+constexpr uint32_t BUILTIN_COMMAND_SEED = findPerfectSeed(BUILTIN_COMMANDS);
+static_assert(BUILTIN_COMMAND_SEED != UINT32_MAX, "no collision-free seed for the built-in commands");
+
+MilitaryManagementSystem::MilitaryManagementSystem()
+    : session(&consoleSession), inventory(weaponCatalog), commands(BUILTIN_COMMAND_SEED), in(&cin), interactive(true) {
+    for (const CommandSpec& spec : BUILTIN_COMMANDS) {
+        auto handler = spec.handler;
+        registerCommand(spec.name, spec.help, [this, handler] { return (this->*handler)(); });
+    }
+    accessIndex.addInventory(0, inventory.getRequiredAccess());
+    addDefaultWeaponsAndWarzones();
+}
+
+bool MilitaryManagementSystem::login(string soldierId) {
+    SoldierHandle h = soldiers.find(soldierId);
+    if (h != SoldierStore::npos) {
+        session->user = h;
+        session->clearance = soldiers.accessLevel(h);
+        session->generation = soldiers.generation();
+        session->replacements = soldiers.replacements();
+        return true;
+    }
+    return false;
+}
+
+void MilitaryManagementSystem::logout() {
+    session->user = SoldierStore::npos;
+    cout << "Logged out successfully.\n";
+}
+
+// The session's soldier, or null if logged out. A session whose handle predates a
+// snapshot load is logged out; its cached clearance is refreshed after replacements.
+Soldier* MilitaryManagementSystem::currentUser() {
+    if (session->user == SoldierStore::npos) return nullptr;
+    if (session->generation != soldiers.generation()) {
+        session->user = SoldierStore::npos;
+        return nullptr;
+    }
+    if (session->replacements != soldiers.replacements()) {
+        session->clearance = soldiers.accessLevel(session->user);
+        session->replacements = soldiers.replacements();
+    }
+    return &soldiers.get(session->user);
+}
+
+// Whether the logged-in soldier (callers check currentUser() first) may see the inventory
+bool MilitaryManagementSystem::inventoryCleared() {
+    return AuditTrail::check(AuditKind::INVENTORY, soldiers.get(session->user).getId(), string_view(), session->clearance,
+                             inventory.getRequiredAccess(), accessIndex.visibleTo(session->clearance).inventories.test(0));
+}
+
+// Whether the logged-in soldier (callers check currentUser() first) holds 'required'
+bool MilitaryManagementSystem::clearedFor(AccessLevel required, string_view resource) {
+    return AuditTrail::check(AuditKind::CLEARANCE, soldiers.get(session->user).getId(), resource, session->clearance,
+                             required, session->clearance >= required);
+}
+
+// Commands whose work grows with the whole force or with a file would hold a
+// CommandServer's stateLock for all of it and stall every other client, so clients of
+// executeLine() are turned away from them; the console and batch runs are not
+bool MilitaryManagementSystem::servedLocally(const string& what) {
+    if (session == &consoleSession) return true;
+    cout << what << " is not available to server clients: it would hold up every other client.\n";
+    return false;
+}
+
+// Confines a server client's file to a plain name inside clientFileDir; console paths
+// are used as given
+bool MilitaryManagementSystem::clientFilePath(string& path) {
+    if (session == &consoleSession) return true;
+    if (clientFileDir.empty()) {
+        cout << "This server does not write files for clients.\n";
+        return false;
+    }
+    if (path.empty() || path[0] == '.' || path.find_first_of("/\\") != string::npos) {
+        cout << "File names from clients must be plain names without directories.\n";
+        return false;
+    }
+    path = clientFileDir + "/" + path;
+    return true;
+}
+
+// Reports a missing or malformed argument from the last read
+bool MilitaryManagementSystem::argumentsOk() const {
+    if (*in) return true;
+    cout << "Missing or invalid arguments.\n";
+    return false;
+}
+
+bool MilitaryManagementSystem::showHelp() {
+    cout << "\n--- Military Management System Commands ---\n";
+    for (const CommandTable::Entry& entry : commands.all()) {
+        if (entry.name == "help") continue;
+        if (entry.name == "logout" && !currentUser()) continue;  // Only show logout option if logged in
+        cout << entry.name << " - " << entry.help << "\n";
+    }
+    cout << "exit - Exit the system\n\n";
+    return true;
+}
+
+
+void MilitaryManagementSystem::showRankInfo() {
+    cout << "\n--- Available Rank Levels ---\n";
+    cout << "1-10: Enlisted\n";
+    cout << "11-20: Officers\n\n";
+}
+
+void MilitaryManagementSystem::showBranchInfo() {
+    cout << "\n--- Available Military Branches ---\n";
+    cout << "1: ARMY\n2: NAVY\n3: AIR_FORCE\n4: MARINES\n5: COAST_GUARD\n6: SPACE_FORCE\n\n";
+}
+
+void MilitaryManagementSystem::showAccessLevelInfo() {
+    cout << "\n--- Available Access Levels ---\n";
+    cout << "1: CONFIDENTIAL\n2: SECRET\n3: TOP_SECRET\n4: SCI\n\n";
+}
+
+
+MilitaryRank MilitaryManagementSystem::createRank() {
+    if (interactive) {
+        showRankInfo(); showAccessLevelInfo(); showBranchInfo();
+    }
+    
+    string name;
+    int rankLevel = 0, accessLevel = 0, branch = 0;
+
+    prompt("Enter Rank Name: "); *in >> name;
+    prompt("Enter Rank Level: "); *in >> rankLevel;
+    prompt("Enter Access Level: "); *in >> accessLevel;
+    prompt("Enter Branch (1-6): "); *in >> branch;
+
+    // Branches are entered as 1-6; out-of-range values are caught by createSoldier()
+    return MilitaryRank(name, rankLevel, static_cast<AccessLevel>(accessLevel), static_cast<MilitaryBranch>(branch - 1));
+}
+
+Soldier* MilitaryManagementSystem::createSoldier() {
+    string soldierId, firstName, lastName, specialization;
+    int experience = 0;
+    MilitaryRank rank = createRank();
+    
+    prompt("Enter Soldier ID: "); *in >> soldierId;
+    prompt("Enter First Name: "); *in >> firstName;
+    prompt("Enter Last Name: "); *in >> lastName;
+    prompt("Enter Specialization: "); *in >> specialization;
+    prompt("Enter Years of Experience: "); *in >> experience;
+    if (!argumentsOk()) return nullptr;
+    if (!isValidAccessLevel(static_cast<int>(rank.getAccessLevel()))) {
+        cout << "Invalid access level.\n";
+        return nullptr;
+    }
+    if (!isValidRankLevel(rank.getRankLevel())) {
+        cout << "Invalid rank level.\n";
+        return nullptr;
+    }
+    if (!isValidBranch(static_cast<int>(rank.getBranch()))) {
+        cout << "Invalid branch.\n";
+        return nullptr;
+    }
+    
+    SoldierHandle h = addSoldier(Soldier(soldierId, firstName, lastName, rank, specialization, experience));
+    return &soldiers.get(h);
+}
+
+// Adds (or replaces) a soldier in the store and logs it to the journal
+SoldierHandle MilitaryManagementSystem::addSoldier(Soldier soldier) {
+    if (journal) {
+        const MilitaryRank& rank = soldier.getRank();
+        journal->append(JournalOp::CREATE_SOLDIER, soldier.getId(), soldier.getFirstName(), soldier.getLastName(),
+                        rank.getName(), static_cast<int32_t>(rank.getRankLevel()), static_cast<uint32_t>(rank.getAccessLevel()),
+                        static_cast<uint32_t>(rank.getBranch()), soldier.getSpecialization(),
+                        static_cast<int32_t>(soldier.getExperienceYears()));
+        for (SkillId skill : soldier.getSkills()) journal->append(JournalOp::ADD_SKILL, soldier.getId(), SkillNames::name(skill));
+    }
+    SoldierHandle h = soldiers.add(move(soldier));
+    if (deployments.state(h) != DeploymentScheduler::OFF) {  // replaced record, may no longer qualify
+        DeploymentScheduler::Moves moves;
+        deployments.replanSoldier(h, soldiers, moves);
+        recordDeployments(moves);
+    }
+    return h;
+}
+
+bool MilitaryManagementSystem::addWeaponManually() {
+    string name, type;
+    int damageRating = 0, range = 0, accuracy = 0, accessLevel = 0;
+
+    prompt("Enter weapon name: ");
+    *in >> name;
+    prompt("Enter type: ");
+    *in >> type;
+    prompt("Enter damage rating: ");
+    *in >> damageRating;
+    prompt("Enter range: ");
+    *in >> range;
+    prompt("Enter accuracy: ");
+    *in >> accuracy;
+    prompt("Enter access level (1-4): ");
+    *in >> accessLevel;
+
+    int quantity = 0;
+    prompt("Enter quantity to add to inventory: ");
+    *in >> quantity;
+    if (!argumentsOk()) return false;
+    if (!isValidAccessLevel(accessLevel)) {
+        cout << "Invalid access level.\n";
+        return false;
+    }
+    if (quantity < 0) {
+        cout << "Quantity cannot be negative.\n";
+        return false;
+    }
+
+    WeaponId newWeapon = addWeaponType(Weapon(name, type, damageRating, range, accuracy, static_cast<AccessLevel>(accessLevel)));
+    inventory.addWeapon(newWeapon, quantity); // 🔥 ADDED THIS LINE
+
+    cout << "Weapon added successfully.\n";
+    return true;
+}
+
+
+
+bool MilitaryManagementSystem::addWarzoneManually() {
+    string id, name, location, description;
+    int accessLevel = 0;
+    prompt("Enter warzone ID: "); *in >> id;
+    prompt("Enter warzone name: "); *in >> name;
+    prompt("Enter warzone location: "); *in >> location;
+    prompt("Enter warzone description: "); *in >> description;
+    prompt("Enter required access level (1-4): "); *in >> accessLevel;
+    if (!argumentsOk()) return false;
+    if (!isValidAccessLevel(accessLevel)) {
+        cout << "Invalid access level.\n";
+        return false;
+    }
+    if (journal) journal->append(JournalOp::ADD_WARZONE, id, name, location, description, static_cast<uint32_t>(accessLevel));
+    addWarzone(Warzone(id, name, location, description, static_cast<AccessLevel>(accessLevel)));
+    rebalanceDeployments();
+    return true;
+}
+
+void MilitaryManagementSystem::addDefaultWeaponsAndWarzones() {
+    addWeaponType(Weapon("Rifle", "Assault", 50, 300, 70, AccessLevel::CONFIDENTIAL));
+    addWeaponType(Weapon("Pistol", "Sidearm", 30, 100, 80, AccessLevel::SECRET));
+    addWeaponType(Weapon("Sniper", "Precision", 100, 600, 90, AccessLevel::TOP_SECRET));
+    
+    Warzone desert("Z1", "Desert Storm", "Middle East", "Tense desert combat zone.", AccessLevel::TOP_SECRET);
+    desert.setPosition(29.31, 47.48);
+    addWarzone(move(desert));
+    Warzone arctic("Z2", "Arctic Warfare", "Northern Region", "Cold and hazardous environment.", AccessLevel::SECRET);
+    arctic.setPosition(69.65, 18.96);
+    addWarzone(move(arctic));
+}
+
+// Interns a weapon definition and makes it visible in the access index
+WeaponId MilitaryManagementSystem::addWeaponType(const Weapon& weapon) {
+    size_t known = weaponCatalog.size();
+    WeaponId id = weaponCatalog.intern(weapon);
+    if (journal && id >= known) {
+        journal->append(JournalOp::DEFINE_WEAPON, id, weapon.getName(), weapon.getType(),
+                        static_cast<int32_t>(weapon.getDamageRating()), static_cast<int32_t>(weapon.getRange()),
+                        static_cast<int32_t>(weapon.getAccuracy()), static_cast<uint32_t>(weapon.getRequiredAccess()));
+    }
+    accessIndex.addWeapon(id, weapon.getRequiredAccess());
+    return id;
+}
+
+// Defines a warzone, or redefines the name, location, description and access level of
+// an existing one. A redefinition keeps the zone's capacity, required skills and map
+// position (unless it brings a position of its own); set_warzone changes those.
+void MilitaryManagementSystem::addWarzone(Warzone warzone) {
+    auto it = warzoneSlots.find(warzone.getId());
+    if (it != warzoneSlots.end()) {
+        const Warzone& current = *warzones[it->second];
+        warzone.setCapacity(current.getCapacity());
+        warzone.setRequiredSkills(current.getRequiredSkills());
+        if (!warzone.hasPosition()) warzone.setPosition(current.getLatitude(), current.getLongitude());
+    }
+    storeWarzone(move(warzone));
+}
+
+// Stores the warzone exactly as given, replacing every setting of an existing one
+void MilitaryManagementSystem::storeWarzone(Warzone warzone) {
+    auto it = warzoneSlots.find(warzone.getId());
+    size_t slot;
+    if (it != warzoneSlots.end()) {
+        slot = it->second;
+        *warzones[slot] = move(warzone);
+    } else {
+        slot = warzones.size();
+        warzones.push_back(warzonePool.create(move(warzone)));
+        warzoneSlots[warzones[slot]->getId()] = slot;
+    }
+    accessIndex.addWarzone(slot, warzones[slot]->getRequiredAccess());
+    const Warzone& stored = *warzones[slot];
+    deployments.setZone(static_cast<uint32_t>(slot),
+                        { stored.getRequiredAccess(), stored.getCapacity(), stored.getRequiredSkills() });
+    warzoneMap.set(static_cast<uint32_t>(slot), stored.getRequiredAccess(), stored.getLatitude(), stored.getLongitude());
+}
+
+// Journals the moves of a planning call
+void MilitaryManagementSystem::recordDeployments(const DeploymentScheduler::Moves& moves) {
+    if (!journal) return;
+    for (const auto& [h, state] : moves) {
+        uint32_t kind = (state == DeploymentScheduler::OFF) ? 0 : (state == DeploymentScheduler::WAITING) ? 1 : 2;
+        journal->append(JournalOp::DEPLOY, soldiers.get(h).getId(), kind, kind == 2 ? warzones[state]->getId() : string());
+    }
+}
+
+// Re-plans the deployment pool after warzones were added or changed
+void MilitaryManagementSystem::rebalanceDeployments() {
+    DeploymentScheduler::Moves moves;
+    deployments.rebalance(soldiers, moves);
+    recordDeployments(moves);
+}
+
+MilitaryManagementSystem::AssignStatus MilitaryManagementSystem::assignWeapon(const string& soldierId, const string& weaponName) {
+    SoldierHandle h = soldiers.find(soldierId);
+    WeaponId weapon = weaponCatalog.find(weaponName);
+    if (h == SoldierStore::npos || weapon == WeaponCatalog::npos) return AssignStatus::NOT_FOUND;
+    AccessLevel clearance = soldiers.accessLevel(h);
+    if (!AuditTrail::check(AuditKind::WEAPON, soldierId, weaponName, clearance, weaponCatalog.get(weapon).getRequiredAccess(),
+                           accessIndex.visibleTo(clearance).weapons.test(weapon))) {
+        return AssignStatus::ACCESS_DENIED;
+    }
+    if (journal) journal->append(JournalOp::ASSIGN_WEAPON, soldierId, weapon);
+    soldiers.get(h).assignWeapon(weapon);
+    return AssignStatus::OK;
+}
+
+MilitaryManagementSystem::AssignStatus MilitaryManagementSystem::assignWarzone(const string& soldierId, const string& warzoneId) {
+    SoldierHandle h = soldiers.find(soldierId);
+    auto it = warzoneSlots.find(warzoneId);
+    if (h == SoldierStore::npos || it == warzoneSlots.end()) return AssignStatus::NOT_FOUND;
+    uint32_t slot = static_cast<uint32_t>(it->second);
+    AccessLevel clearance = soldiers.accessLevel(h);
+    if (!AuditTrail::check(AuditKind::WARZONE, soldierId, warzoneId, clearance, warzones[slot]->getRequiredAccess(),
+                           accessIndex.visibleTo(clearance).warzones.test(slot))) {
+        return AssignStatus::ACCESS_DENIED;
+    }
+    SkillList skills;
+    soldiers.copySkills(h, skills);
+    if (!DeploymentScheduler::qualifies(soldiers.accessLevel(h), skills, deployments.zone(slot))) return AssignStatus::MISSING_SKILLS;
+    DeploymentScheduler::Moves moves;
+    if (!deployments.place(h, slot, soldiers, moves)) return AssignStatus::FULL;
+    recordDeployments(moves);
+    return AssignStatus::OK;
+}
+
+bool MilitaryManagementSystem::assignUnit(const string& soldierId, const string& unitName) {
+    SoldierHandle h = soldiers.find(soldierId);
+    if (h == SoldierStore::npos) return false;
+    if (journal) journal->append(JournalOp::ASSIGN_UNIT, soldierId, unitName);
+    soldiers.setUnit(h, soldiers.internUnit(unitName));
+    return true;
+}
+
+bool MilitaryManagementSystem::promote(const string& soldierId, const string& rankName, int rankLevel) {
+    SoldierHandle h = soldiers.find(soldierId);
+    if (h == SoldierStore::npos || !isValidRankLevel(rankLevel)) return false;
+    if (journal) journal->append(JournalOp::PROMOTE, soldierId, rankName, static_cast<int32_t>(rankLevel));
+    soldiers.promote(h, rankName, rankLevel);
+    return true;
+}
+
+bool MilitaryManagementSystem::assignWeaponToSoldier() {
+    string soldierId, weaponName;
+    prompt("Enter Soldier ID: "); *in >> soldierId;
+    prompt("Enter Weapon Name: "); *in >> weaponName;
+    if (!argumentsOk()) return false;
+    
+    switch (assignWeapon(soldierId, weaponName)) {
+    case AssignStatus::OK:
+        cout << "Weapon assigned successfully.\n";
+        return true;
+    case AssignStatus::ACCESS_DENIED:
+        cout << "Insufficient access level to assign this weapon.\n";
+        return false;
+    default:
+        cout << "Soldier or weapon not found.\n";
+        return false;
+    }
+}
+
+bool MilitaryManagementSystem::assignWarzoneToSoldier() {
+    string soldierId, warzoneId;
+    prompt("Enter Soldier ID: "); *in >> soldierId;
+    prompt("Enter Warzone ID: "); *in >> warzoneId;
+    if (!argumentsOk()) return false;
+    
+    switch (assignWarzone(soldierId, warzoneId)) {
+    case AssignStatus::OK:
+        cout << "Warzone assigned to soldier.\n";
+        return true;
+    case AssignStatus::ACCESS_DENIED:
+        cout << "Insufficient access level to assign to this warzone.\n";
+        return false;
+    case AssignStatus::MISSING_SKILLS:
+        cout << "Soldier lacks skills this warzone requires.\n";
+        return false;
+    case AssignStatus::FULL:
+        cout << "Warzone is at capacity.\n";
+        return false;
+    default:
+        cout << "Soldier or warzone not found.\n";
+        return false;
+    }
+}
+
+bool MilitaryManagementSystem::assignUnitCommand() {
+    string soldierId, unitName;
+    prompt("Enter Soldier ID: "); *in >> soldierId;
+    prompt("Enter Unit Name: "); *in >> unitName;
+    if (!argumentsOk()) return false;
+
+    if (!assignUnit(soldierId, unitName)) {
+        cout << "Soldier not found.\n";
+        return false;
+    }
+    cout << "Soldier assigned to unit " << unitName << ".\n";
+    return true;
+}
+
+bool MilitaryManagementSystem::promoteCommand() {
+    string soldierId, rankName;
+    int rankLevel;
+    prompt("Enter Soldier ID: "); *in >> soldierId;
+    prompt("Enter New Rank Name: "); *in >> rankName;
+    prompt("Enter New Rank Level (1-20): "); *in >> rankLevel;
+    if (!argumentsOk()) return false;
+
+    if (!isValidRankLevel(rankLevel)) {
+        cout << "Invalid rank level. Must be between " << MIN_RANK_LEVEL << " and " << MAX_RANK_LEVEL << ".\n";
+        return false;
+    }
+    if (!promote(soldierId, rankName, rankLevel)) {
+        cout << "Soldier not found.\n";
+        return false;
+    }
+    cout << "Soldier " << soldierId << " is now " << rankName << " (Level " << rankLevel << ").\n";
+    return true;
+}
+
+// seniority top <scope> <k> | nth <scope> <n> | rank <scope> <soldierId>
+// Scope is "force", a branch (name or 1-6) or unit=<name>. Seniority orders by rank
+// level, then years of experience, then enrolment order.
+bool MilitaryManagementSystem::seniorityCommand() {
+    string mode, scope, argument;
+    prompt("Enter query (top, nth, rank): "); *in >> mode;
+    prompt("Enter scope (force, branch or unit=<name>): "); *in >> scope;
+    prompt("Enter count, position or Soldier ID: "); *in >> argument;
+    if (!argumentsOk()) return false;
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+
+    uint32_t group;
+    MilitaryBranch branch;
+    if (scope == "force") {
+        group = SeniorityIndex::FORCE;
+    } else if (scope.compare(0, 5, "unit=") == 0) {
+        uint32_t unit = soldiers.findUnit(scope.substr(5));
+        if (unit == 0) {
+            cout << "Unknown unit: " << scope.substr(5) << "\n";
+            return false;
+        }
+        group = SeniorityIndex::unitGroup(unit);
+    } else if (parseBranch(scope, branch)) {
+        group = SeniorityIndex::branchGroup(branch);
+    } else {
+        cout << "Invalid scope: " << scope << "\n";
+        return false;
+    }
+
+    const SeniorityIndex& seniority = soldiers.seniorityIndex();
+    size_t total = seniority.size(group);
+    ReportWriter out(cout);
+    if (mode == "rank") {
+        SoldierHandle h = soldiers.find(argument);
+        if (h == SoldierStore::npos) {
+            cout << "Soldier not found.\n";
+            return false;
+        }
+        bool member = group == SeniorityIndex::FORCE ||
+                      (group <= BRANCH_COUNT ? SeniorityIndex::branchGroup(soldiers.branch(h)) == group
+                                             : SeniorityIndex::unitGroup(soldiers.unit(h)) == group);
+        if (!member) {
+            cout << "Soldier " << argument << " is not in " << scope << ".\n";
+            return false;
+        }
+        out << argument << " is #" << soldiers.seniorityRank(group, h) + 1 << " of " << total << " in " << scope << ".\n";
+        return true;
+    }
+
+    int n;
+    if (!parseInt(argument, n) || n < 1) {
+        cout << "Invalid number: " << argument << "\n";
+        return false;
+    }
+    if (mode == "top") {
+        size_t position = 0;
+        seniority.forEachTop(group, static_cast<size_t>(n), [&](SoldierHandle h) {
+            out << ++position << ". ";
+            soldiers.writeRosterLine(out, h);
+        });
+        out << position << " of " << total << " shown.\n";
+        return true;
+    }
+    if (mode == "nth") {
+        if (static_cast<size_t>(n) > total) {
+            cout << scope << " has only " << total << " soldiers.\n";
+            return false;
+        }
+        out << n << ". ";
+        soldiers.writeRosterLine(out, seniority.nth(group, static_cast<size_t>(n) - 1));
+        return true;
+    }
+    cout << "Unknown seniority query: " << mode << "\n";
+    return false;
+}
+
+// Resolves a command target: one soldier ID, unit=NAME or force. Units and the force
+// come most senior first.
+bool MilitaryManagementSystem::collectTargets(const string& target, vector<SoldierHandle>& handles) {
+    if (target == "force" || target.compare(0, 5, "unit=") == 0) {
+        uint32_t group = SeniorityIndex::FORCE;
+        if (target != "force") {
+            uint32_t unit = soldiers.findUnit(target.substr(5));
+            if (unit == 0) {
+                cout << "Unknown unit: " << target.substr(5) << "\n";
+                return false;
+            }
+            group = SeniorityIndex::unitGroup(unit);
+        }
+        const SeniorityIndex& seniority = soldiers.seniorityIndex();
+        handles.reserve(seniority.size(group));
+        seniority.forEachTop(group, seniority.size(group), [&](SoldierHandle h) { handles.push_back(h); });
+        return true;
+    }
+    SoldierHandle h = soldiers.find(target);
+    if (h == SoldierStore::npos) {
+        cout << "Soldier not found.\n";
+        return false;
+    }
+    handles.push_back(h);
+    return true;
+}
+
+// optimize_loadout <soldierId|unit=NAME|force> [slots=N] [damage=W] [range=W] [accuracy=W]
+//                  [limit=N] [apply]
+// Plans in seniority order, so senior soldiers get first pick of scarce stock. With
+// 'apply' the planned weapons are taken from the inventory and assigned.
+bool MilitaryManagementSystem::optimizeLoadoutCommand() {
+    string line;
+    getline(*in, line);
+    if (interactive && line.find_first_not_of(" \t\r") == string::npos) {
+        prompt("Enter target and options (e.g. unit=Alpha slots=2 apply): ");
+        getline(*in, line);
+    }
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+
+    auto parseWeight = [](string_view text, float& weight) {
+        string value(text);
+        char* end = nullptr;
+        weight = strtof(value.c_str(), &end);
+        return !value.empty() && end == value.c_str() + value.size() && isfinite(weight);
+    };
+
+    istringstream words(line);
+    string target, word;
+    words >> target;
+    LoadoutWeights weights;
+    int slots = 2, limit = 20;
+    bool apply = false;
+    while (words >> word) {
+        size_t equals = word.find('=');
+        string_view key = string_view(word).substr(0, min(equals, word.size()));
+        string_view value = (equals == string::npos) ? string_view() : string_view(word).substr(equals + 1);
+        bool ok;
+        if (word == "apply") {
+            apply = true;
+            ok = true;
+        } else if (key == "slots") {
+            ok = parseInt(value, slots) && slots >= 1 && slots <= 16;
+        } else if (key == "limit") {
+            ok = parseInt(value, limit) && limit >= 0;
+        } else if (key == "damage") {
+            ok = parseWeight(value, weights.damage);
+        } else if (key == "range") {
+            ok = parseWeight(value, weights.range);
+        } else if (key == "accuracy") {
+            ok = parseWeight(value, weights.accuracy);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            cout << "Invalid option: " << word << "\n";
+            return false;
+        }
+    }
+    if (apply && !inventoryCleared()) {  // issuing takes stock, like 'issue'
+        cout << "Access denied to inventory.\n";
+        return false;
+    }
+
+    // Soldiers to outfit, most senior first
+    vector<SoldierHandle> handles;
+    if (!collectTargets(target, handles)) return false;
+    if (handles.size() > CLIENT_TARGET_LIMIT && !servedLocally("optimize_loadout for " + target)) return false;
+
+    LoadoutOptimizer optimizer(weaponCatalog, inventory, weights, static_cast<size_t>(slots));
+    for (SoldierHandle h : handles) optimizer.addSoldier(soldiers.accessLevel(h), soldiers.get(h).getWeapons());
+    LoadoutOptimizer::Plan plan = optimizer.solve();
+
+    ReportWriter out(cout);
+    size_t issued = 0;
+    for (size_t i = 0; i < handles.size(); ++i) {
+        const WeaponId* picks = &plan.picks[i * plan.slots];
+        Soldier& soldier = soldiers.get(handles[i]);
+        if (i < static_cast<size_t>(limit)) {
+            out << soldier.getId() << ": ";
+            if (picks[0] == WeaponCatalog::npos) out << "(nothing to add)";
+            for (size_t k = 0; k < plan.slots && picks[k] != WeaponCatalog::npos; ++k) {
+                if (k) out << ", ";
+                out << weaponCatalog.get(picks[k]).getName();
+            }
+            out << " (score " << static_cast<long long>(lround(plan.scores[i])) << ")\n";
+        }
+        for (size_t k = 0; apply && k < plan.slots && picks[k] != WeaponCatalog::npos; ++k) {
+            if (!inventory.tryRemoveWeapon(picks[k], 1)) continue;  // stock changed since planning
+            if (journal) journal->append(JournalOp::ASSIGN_WEAPON, soldier.getId(), picks[k]);
+            soldier.assignWeapon(picks[k]);
+            ++issued;
+        }
+    }
+    if (handles.size() > static_cast<size_t>(limit)) out << "... (" << handles.size() - limit << " more)\n";
+    out << "Planned " << plan.weapons << " weapons for " << handles.size() << " soldiers, total score "
+        << static_cast<long long>(llround(plan.totalScore)) << ".\n";
+    if (apply) out << "Issued " << issued << " weapons.\n";
+    return true;
+}
+
+// add_supply <id> <quantity> <description...>
+bool MilitaryManagementSystem::addSupplyCommand() {
+    string supplyId, description;
+    int quantity = 0;
+    prompt("Enter supply ID: "); *in >> supplyId;
+    prompt("Enter quantity: "); *in >> quantity;
+    prompt("Enter description: "); getline(*in >> ws, description);
+    if (!argumentsOk()) return false;
+    if (quantity <= 0) {
+        cout << "Quantity must be positive.\n";
+        return false;
+    }
+    inventory.addSupply(supplyId, description, quantity);
+    cout << "Supply added successfully.\n";
+    return true;
+}
+
+// issue <soldierId> weapon:<name>=<qty> supply:<id>=<qty> ...
+// Either every item is taken from stock or none is. Weapons are assigned to the
+// soldier, who must be cleared for each of them.
+bool MilitaryManagementSystem::issueCommand() {
+    string line;
+    getline(*in, line);
+    if (interactive && line.find_first_not_of(" \t\r") == string::npos) {
+        prompt("Enter soldier and items (e.g. S1 weapon:Rifle=3 supply:MED=10): ");
+        getline(*in, line);
+    }
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+    if (!inventoryCleared()) {
+        cout << "Access denied to inventory.\n";
+        return false;
+    }
+
+    istringstream words(line);
+    string soldierId, word;
+    words >> soldierId;
+    SoldierHandle h = soldiers.find(soldierId);
+    if (h == SoldierStore::npos) {
+        cout << "Soldier not found.\n";
+        return false;
+    }
+
+    InventoryTransaction transaction(inventory);
+    vector<pair<WeaponId, int>> weapons;
+    size_t items = 0;
+    while (words >> word) {
+        size_t colon = word.find(':'), equals = word.rfind('=');
+        int quantity = 0;
+        bool ok = colon != string::npos && equals != string::npos && colon < equals &&
+                  parseInt(string_view(word).substr(equals + 1), quantity) && quantity > 0;
+        string kind = ok ? word.substr(0, colon) : string(), name = ok ? word.substr(colon + 1, equals - colon - 1) : string();
+        if (ok && kind == "weapon") {
+            WeaponId weapon = weaponCatalog.find(name);
+            if (weapon == WeaponCatalog::npos) {
+                cout << "Unknown weapon: " << name << "\n";
+                return false;
+            }
+            AccessLevel clearance = soldiers.accessLevel(h);
+            if (!AuditTrail::check(AuditKind::WEAPON, soldierId, name, clearance, weaponCatalog.get(weapon).getRequiredAccess(),
+                                   accessIndex.visibleTo(clearance).weapons.test(weapon))) {
+                cout << "Soldier " << soldierId << " is not cleared for " << name << ".\n";
+                return false;
+            }
+            transaction.addWeapon(weapon, quantity);
+            weapons.push_back({ weapon, quantity });
+        } else if (ok && kind == "supply") {
+            transaction.addSupply(name, quantity);
+        } else {
+            cout << "Invalid item: " << word << "\n";
+            return false;
+        }
+        ++items;
+    }
+    if (items == 0) {
+        cout << "Nothing to issue.\n";
+        return false;
+    }
+
+    if (!transaction.reserve()) {
+        cout << "Not enough stock: " << transaction.shortItem() << ". Nothing was issued.\n";
+        return false;
+    }
+    Soldier& soldier = soldiers.get(h);
+    for (const auto& [weapon, quantity] : weapons) {
+        for (int i = 0; i < quantity; ++i) {
+            if (journal) journal->append(JournalOp::ASSIGN_WEAPON, soldierId, weapon);
+            soldier.assignWeapon(weapon);
+        }
+    }
+    transaction.commit();
+    cout << "Issued to " << soldierId << ".\n";
+    return true;
+}
+
+// set_warzone <warzoneId> [capacity=N] [skills=A;B] [position=LAT,LON|none]
+// Capacity 0 means unlimited and an empty skills= clears the requirement. Deployments
+// that no longer fit are re-planned straight away.
+bool MilitaryManagementSystem::setWarzoneCommand() {
+    string line;
+    getline(*in, line);
+    if (interactive && line.find_first_not_of(" \t\r") == string::npos) {
+        prompt("Enter warzone and settings (e.g. Z1 capacity=50 skills=Medic;Pilot position=29.3,47.5): ");
+        getline(*in, line);
+    }
+
+    istringstream words(line);
+    string warzoneId, word;
+    words >> warzoneId;
+    auto it = warzoneSlots.find(warzoneId);
+    if (it == warzoneSlots.end()) {
+        cout << "Warzone not found.\n";
+        return false;
+    }
+    Warzone warzone = *warzones[it->second];
+    bool limitsSet = false, positionSet = false;
+    while (words >> word) {
+        size_t equals = word.find('=');
+        string_view key = string_view(word).substr(0, min(equals, word.size()));
+        string_view value = (equals == string::npos) ? string_view() : string_view(word).substr(equals + 1);
+        int capacity = 0;
+        double latitude = 0, longitude = 0;
+        if (key == "capacity" && parseInt(value, capacity) && capacity >= 0) {
+            warzone.setCapacity(static_cast<uint32_t>(capacity));
+            limitsSet = true;
+        } else if (key == "skills" && equals != string::npos) {
+            warzone.setRequiredSkills(parseSkillList(value));
+            limitsSet = true;
+        } else if (key == "position" && value == "none") {
+            warzone.setPosition(NAN, NAN);
+            positionSet = true;
+        } else if (key == "position" && parsePosition(value, latitude, longitude)) {
+            warzone.setPosition(latitude, longitude);
+            positionSet = true;
+        } else {
+            cout << "Invalid option: " << word << "\n";
+            return false;
+        }
+    }
+
+    if (journal && limitsSet) {
+        journal->append(JournalOp::WARZONE_LIMITS, warzoneId, warzone.getCapacity(), joinSkillList(warzone.getRequiredSkills()));
+    }
+    if (journal && positionSet) journal->append(JournalOp::WARZONE_POSITION, warzoneId, warzone.getLatitude(), warzone.getLongitude());
+    storeWarzone(move(warzone));
+    if (limitsSet) rebalanceDeployments();
+    cout << "Warzone " << warzoneId << " updated.\n";
+    return true;
+}
+
+// deploy <soldierId|unit=NAME|force>
+// Adds the soldiers to the deployment pool, then plans the whole pool for as many
+// deployments as warzone access, skills and capacities allow.
+bool MilitaryManagementSystem::deployCommand() {
+    string target;
+    prompt("Enter soldier ID, unit=NAME or force: "); *in >> target;
+    if (!argumentsOk()) return false;
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+    vector<SoldierHandle> handles;
+    if (!collectTargets(target, handles)) return false;
+    if (handles.size() > CLIENT_TARGET_LIMIT && !servedLocally("deploy " + target)) return false;
+
+    DeploymentScheduler::Moves moves;
+    deployments.solve(handles, soldiers, moves);
+    recordDeployments(moves);
+    size_t deployed = 0;
+    for (uint32_t slot = 0; slot < deployments.zoneCount(); ++slot) deployed += deployments.load(slot);
+    cout << "Deployed " << deployed << " soldiers, " << deployments.waitingCount() << " waiting (" << moves.size()
+         << " changed).\n";
+    return true;
+}
+
+bool MilitaryManagementSystem::withdrawCommand() {
+    string soldierId;
+    prompt("Enter Soldier ID: "); *in >> soldierId;
+    if (!argumentsOk()) return false;
+    SoldierHandle h = soldiers.find(soldierId);
+    if (h == SoldierStore::npos) {
+        cout << "Soldier not found.\n";
+        return false;
+    }
+    DeploymentScheduler::Moves moves;
+    if (!deployments.withdraw(h, soldiers, moves)) {
+        cout << "Soldier is not in the deployment pool.\n";
+        return false;
+    }
+    recordDeployments(moves);
+    cout << "Soldier withdrawn";
+    if (moves.size() > 1) cout << ", " << moves.size() - 1 << " deployments changed";
+    cout << ".\n";
+    return true;
+}
+
+// deployments [warzoneId]
+bool MilitaryManagementSystem::deploymentsCommand() {
+    string line, warzoneId;
+    getline(*in, line);
+    istringstream(line) >> warzoneId;
+
+    ReportWriter out(cout);
+    if (warzoneId.empty()) {
+        for (uint32_t slot = 0; slot < warzones.size(); ++slot) {
+            const Warzone& warzone = *warzones[slot];
+            out << warzone.getId() << ' ';
+            warzone.write(out);
+            out << ": " << deployments.load(slot);
+            if (warzone.getCapacity()) out << '/' << warzone.getCapacity();
+            out << " deployed";
+            if (!warzone.getRequiredSkills().empty()) out << ", requires " << joinSkillList(warzone.getRequiredSkills());
+            out << '\n';
+        }
+        out << "Waiting: " << deployments.waitingCount() << '\n';
+        return true;
+    }
+
+    auto it = warzoneSlots.find(warzoneId);
+    if (it == warzoneSlots.end()) {
+        out << "Warzone not found.\n";
+        return false;
+    }
+    const size_t shown = 20;
+    size_t listed = 0;
+    for (SoldierHandle h = 0; h < soldiers.size(); ++h) {
+        if (deployments.state(h) != it->second) continue;
+        if (listed++ < shown) soldiers.writeRosterLine(out, h);
+    }
+    if (listed > shown) out << "... (" << listed - shown << " more)\n";
+    out << listed << " deployed to " << warzoneId << ".\n";
+    return true;
+}
+
+// nearby_warzones <LAT,LON|warzoneId> [k=N] [radius=KM]
+// Warzones the logged-in soldier is cleared for, nearest first: the k nearest (5 by
+// default), or with radius= all of them within that distance, capped by k= if given.
+bool MilitaryManagementSystem::nearbyWarzonesCommand() {
+    string line;
+    getline(*in, line);
+    if (interactive && line.find_first_not_of(" \t\r") == string::npos) {
+        prompt("Enter position or warzone and options (e.g. 29.3,47.5 radius=500): ");
+        getline(*in, line);
+    }
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+
+    istringstream words(line);
+    string origin, word;
+    words >> origin;
+    double latitude = 0, longitude = 0;
+    auto it = warzoneSlots.find(origin);
+    if (it != warzoneSlots.end()) {
+        const Warzone& from = *warzones[it->second];
+        if (!from.hasPosition()) {
+            cout << "Warzone " << origin << " has no position.\n";
+            return false;
+        }
+        latitude = from.getLatitude();
+        longitude = from.getLongitude();
+    } else if (!parsePosition(origin, latitude, longitude)) {
+        cout << "Unknown warzone or invalid position: " << origin << "\n";
+        return false;
+    }
+
+    int k = 0;
+    double radius = INFINITY;
+    while (words >> word) {
+        size_t equals = word.find('=');
+        string_view key = string_view(word).substr(0, min(equals, word.size()));
+        string_view value = (equals == string::npos) ? string_view() : string_view(word).substr(equals + 1);
+        bool ok = (key == "k") ? parseInt(value, k) && k >= 1 : (key == "radius") && parseDouble(value, radius) && radius >= 0;
+        if (!ok) {
+            cout << "Invalid option: " << word << "\n";
+            return false;
+        }
+    }
+    size_t limit = (k > 0) ? static_cast<size_t>(k) : isinf(radius) ? 5 : SIZE_MAX;
+
+    vector<WarzoneMap::Hit> hits = warzoneMap.nearest(latitude, longitude, session->clearance, limit, radius);
+    ReportWriter out(cout);
+    const size_t shown = (k > 0) ? hits.size() : 20;
+    for (size_t i = 0; i < hits.size() && i < shown; ++i) {
+        const Warzone& warzone = *warzones[hits[i].slot];
+        long long tenths = llround(hits[i].km * 10);
+        out << warzone.getId() << ' ';
+        warzone.write(out);
+        out << " - " << tenths / 10 << '.' << static_cast<char>('0' + tenths % 10) << " km\n";
+    }
+    if (hits.size() > shown) out << "... (" << hits.size() - shown << " more)\n";
+    if (hits.empty()) out << "No accessible warzones found.\n";
+    return true;
+}
+
+// audit <soldierId|*> [from=TIME] [to=TIME] [limit=N]
+// The newest matching access decisions (50 by default), oldest first. TIME is Unix
+// seconds or a UTC date with an optional time, e.g. 2026-10-16 or 2026-10-16T08:30:00.
+// Needs AUDIT_ACCESS, since it shows every soldier's decisions.
+bool MilitaryManagementSystem::auditCommand() {
+    string line;
+    getline(*in, line);
+    if (interactive && line.find_first_not_of(" \t\r") == string::npos) {
+        prompt("Enter soldier (* for all) and options (e.g. S1 from=2026-10-16 limit=20): ");
+        getline(*in, line);
+    }
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+    if (!clearedFor(AUDIT_ACCESS, "audit")) {
+        cout << "Access denied: the audit trail needs SCI clearance.\n";
+        return false;
+    }
+    AuditTrail& trail = AuditTrail::instance();
+    if (!trail.isOpen()) {
+        cout << "Auditing is off (start with --audit <file>).\n";
+        return false;
+    }
+
+    istringstream words(line);
+    string soldierId, word;
+    if (!(words >> soldierId)) {
+        cout << "Soldier ID required.\n";
+        return false;
+    }
+    AuditTrail::Query query;
+    if (soldierId != "*") query.soldierId = soldierId;
+    int limit = 50;
+    while (words >> word) {
+        size_t equals = word.find('=');
+        string key = word.substr(0, min(equals, word.size()));
+        string value = (equals == string::npos) ? string() : word.substr(equals + 1);
+        bool ok = false;
+        if (key == "from") {
+            ok = parseUtc(value, query.fromNs);
+        } else if (key == "to" && parseUtc(value, query.toNs)) {
+            query.toNs += min<uint64_t>(999999999, UINT64_MAX - query.toNs);  // up to the end of that second
+            ok = true;
+        } else if (key == "limit") {
+            ok = parseInt(value, limit) && limit >= 1;
+        }
+        if (!ok) {
+            cout << "Invalid option: " << word << "\n";
+            return false;
+        }
+    }
+
+    deque<AuditRecord> newest;
+    size_t matches = 0;
+    trail.search(query, [&](const AuditRecord& record) {
+        newest.push_back(record);
+        if (newest.size() > static_cast<size_t>(limit)) newest.pop_front();
+        ++matches;
+        return true;
+    });
+    // Blocks are written per drain, so records of slow threads may trail slightly
+    stable_sort(newest.begin(), newest.end(), [](const AuditRecord& a, const AuditRecord& b) { return a.timeNs < b.timeNs; });
+
+    ReportWriter out(cout);
+    if (matches > newest.size()) out << "... (" << matches - newest.size() << " earlier)\n";
+    for (const AuditRecord& record : newest) {
+        out << formatUtc(record.timeNs) << ' ' << record.soldierId() << ' ' << AUDIT_KIND_NAMES[static_cast<int>(record.kind)];
+        if (!record.resourceName().empty()) out << ' ' << record.resourceName();
+        out << (record.granted ? " granted" : " DENIED") << " (clearance " << record.clearance << ", requires "
+            << record.required << ")\n";
+    }
+    if (matches == 0) out << "No matching access decisions.\n";
+    if (uint64_t dropped = trail.dropped()) out << dropped << " decisions were not recorded (audit buffers full).\n";
+    return true;
+}
+
+bool MilitaryManagementSystem::displaySoldierInfo() {
+    if (Soldier* user = currentUser()) {
+        ReportWriter out(cout);
+        user->writeInfo(out);
+
+        // Show assigned weapons
+        const auto& weapons = user->getWeapons();
+        if (!weapons.empty()) {
+            out << "Assigned Weapons:\n";
+            for (WeaponId weapon : weapons) {
+                out << "- Weapon: ";
+                weaponCatalog.get(weapon).write(out);
+                out << '\n';
+            }
+        } else {
+            out << "No weapons assigned.\n";
+        }
+
+        // Show accessible warzones
+        out << "Accessible Warzones:\n";
+        bool hasAccess = false;
+        accessIndex.visibleTo(session->clearance).warzones.forEach([&](size_t slot) {
+            out << "- ";
+            warzones[slot]->write(out);
+            out << '\n';
+            hasAccess = true;
+        });
+        if (!hasAccess) {
+            out << "No accessible warzones.\n";
+        }
+        return true;
+    } else {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+}
+
+// find_soldiers [branch=NAVY,ARMY] [access=SECRET..] [rank=11..20] [experience=..5]
+//               [specialization=Medic] [limit=N]
+// Ranges are lo..hi with either end optional; a single value matches exactly.
+bool MilitaryManagementSystem::findSoldiersCommand() {
+    string filters;
+    getline(*in, filters);
+    if (interactive && filters.find_first_not_of(" \t\r") == string::npos) {
+        prompt("Enter filters (e.g. branch=NAVY access=SECRET.. rank=11..20): ");
+        getline(*in, filters);
+    }
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+
+    // Parses "v", "lo..hi", "lo.." or "..hi" with parseOne for each end
+    auto parseRange = [](string_view value, int& lo, int& hi, auto parseOne) {
+        size_t dots = value.find("..");
+        if (dots == string_view::npos) return parseOne(value, lo) && parseOne(value, hi);
+        string_view from = value.substr(0, dots), to = value.substr(dots + 2);
+        return (from.empty() || parseOne(from, lo)) && (to.empty() || parseOne(to, hi));
+    };
+    auto parseLevel = [](string_view text, int& level) {
+        AccessLevel parsed;
+        if (!parseAccessLevel(text, parsed)) return false;
+        level = static_cast<int>(parsed);
+        return true;
+    };
+
+    SoldierQuery query;
+    int limit = 20;
+    istringstream words(filters);
+    string word;
+    while (words >> word) {
+        size_t equals = word.find('=');
+        string_view key = string_view(word).substr(0, min(equals, word.size()));
+        string_view value = (equals == string::npos) ? string_view() : string_view(word).substr(equals + 1);
+        bool ok = equals != string::npos && !value.empty();
+        if (ok && key == "branch") {
+            while (ok && !value.empty()) {
+                size_t comma = value.find(',');
+                MilitaryBranch branch;
+                ok = parseBranch(value.substr(0, comma), branch);
+                if (ok) query.branches |= 1u << static_cast<int>(branch);
+                value = (comma == string_view::npos) ? string_view() : value.substr(comma + 1);
+            }
+        } else if (ok && key == "access") {
+            ok = parseRange(value, query.minAccess, query.maxAccess, parseLevel);
+        } else if (ok && key == "rank") {
+            ok = parseRange(value, query.minRank, query.maxRank, parseInt);
+        } else if (ok && key == "experience") {
+            ok = parseRange(value, query.minExperience, query.maxExperience, parseInt);
+        } else if (ok && key == "specialization") {
+            query.specialization = string(value);
+        } else if (ok && key == "limit") {
+            ok = parseInt(value, limit) && limit >= 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            cout << "Invalid filter: " << word << "\n";
+            return false;
+        }
+    }
+
+    vector<SoldierHandle> matches = soldiers.query(query);
+    ReportWriter out(cout);
+    for (size_t i = 0; i < matches.size() && i < static_cast<size_t>(limit); ++i) soldiers.writeRosterLine(out, matches[i]);
+    out << matches.size() << " soldiers match";
+    if (matches.size() > static_cast<size_t>(limit)) out << " (first " << limit << " shown)";
+    out << ".\n";
+    return true;
+}
+
+// report <inventory|roster|loadouts> <file>  ('-' writes to the console)
+bool MilitaryManagementSystem::reportCommand() {
+    string kind, path;
+    prompt("Enter report (inventory, roster, loadouts): ");
+    *in >> kind;
+    prompt("Enter output file (- for console): ");
+    *in >> path;
+    if (!argumentsOk()) return false;
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
+    }
+    if (kind != "inventory" && kind != "roster" && kind != "loadouts") {
+        cout << "Unknown report: " << kind << "\n";
+        return false;
+    }
+    if (kind == "inventory" && !inventoryCleared()) {
+        cout << "Access denied to inventory.\n";
+        return false;
+    }
+    if (kind != "inventory" && !clearedFor(FORCE_REPORT_ACCESS, kind)) {
+        cout << "Access denied: the " << kind << " report needs TOP_SECRET clearance.\n";
+        return false;
+    }
+    if (kind != "inventory" && !servedLocally("The " + kind + " report")) return false;
+    string filePath = path;
+    if (path != "-" && !clientFilePath(filePath)) return false;
+
+    FILE* file = nullptr;
+    if (path != "-") {
+        file = fopen(filePath.c_str(), "wb");
+        if (!file) {
+            cout << "Cannot open report file " << path << ".\n";
+            return false;
+        }
+        setvbuf(file, nullptr, _IONBF, 0);  // the writer already hands over 64 KiB blocks
+    }
+    bool ok;
+    uint64_t bytes;
+    {
+        ReportWriter out = file ? ReportWriter(file) : ReportWriter(cout);
+        if (kind == "inventory") {
+            inventory.writeInfo(out);
+        } else if (kind == "roster") {
+            soldiers.writeRoster(out);
+        } else {
+            soldiers.writeLoadouts(out, weaponCatalog);
+        }
+        ok = out.flush();
+        bytes = out.bytesWritten();
+    }
+    if (file && fclose(file) != 0) ok = false;
+    if (!ok) {
+        cout << "Failed to write report " << path << ".\n";
+        return false;
+    }
+    if (file) cout << "Report written to " << path << " (" << bytes << " bytes).\n";
+    return true;
+}
+
+
+// Writes every soldier, rank, weapon definition, warzone and inventory entry to a
+// snapshot. The file is built next to 'path' and renamed over it once synced.
+bool MilitaryManagementSystem::saveSnapshot(const string& path) {
+    SnapshotWriter writer;
+    if (!writer.open(path)) return false;
+
+    // Soldiers: hot columns straight from the store, cold records flattened
+    size_t count = soldiers.size();
+    writer.writeSection(SECTION_RANK_LEVELS, soldiers.rankLevelColumn().data(), count);
+    writer.writeSection(SECTION_ACCESS_LEVELS, soldiers.accessLevelColumn().data(), count);
+    writer.writeSection(SECTION_BRANCHES, soldiers.branchColumn().data(), count);
+    writer.writeSection(SECTION_UNITS, soldiers.unitColumn().data(), count);
+    vector<SnapshotString> unitNames;
+    for (uint32_t unit = 1; unit <= soldiers.unitCount(); ++unit) unitNames.push_back(writer.addString(soldiers.unitName(unit)));
+    writer.writeSection(SECTION_UNIT_NAMES, unitNames.data(), unitNames.size());
+
+    vector<SnapshotSoldier> records(count);
+    vector<SnapshotString> skills;
+    vector<WeaponId> loadouts;
+    for (SoldierHandle h = 0; h < count; ++h) {
+        const Soldier& soldier = soldiers.get(h);
+        SnapshotSoldier& rec = records[h];
+        rec.id = writer.addString(soldier.getId());
+        rec.firstName = writer.addString(soldier.getFirstName());
+        rec.lastName = writer.addString(soldier.getLastName());
+        rec.rankName = writer.addString(soldier.getRank().getName(), true);
+        rec.specialization = writer.addString(soldier.getSpecialization(), true);
+        rec.experienceYears = soldier.getExperienceYears();
+        rec.skillsBegin = static_cast<uint32_t>(skills.size());
+        rec.skillCount = static_cast<uint32_t>(soldier.getSkills().size());
+        for (SkillId skill : soldier.getSkills()) skills.push_back(writer.addString(SkillNames::name(skill), true));
+        rec.weaponsBegin = static_cast<uint32_t>(loadouts.size());
+        rec.weaponCount = static_cast<uint32_t>(soldier.getWeapons().size());
+        loadouts.insert(loadouts.end(), soldier.getWeapons().begin(), soldier.getWeapons().end());
+    }
+
+    // ID index: handles sorted by soldier ID, so a mapped image can be searched directly
+    vector<SoldierHandle> sorted(count);
+    vector<string> ids(count);
+    for (SoldierHandle h = 0; h < count; ++h) {
+        sorted[h] = h;
+        ids[h] = soldiers.get(h).getId();
+    }
+    sort(sorted.begin(), sorted.end(), [&](SoldierHandle a, SoldierHandle b) { return ids[a] < ids[b]; });
+    ids.clear();
+
+    writer.writeSection(SECTION_SOLDIERS, records.data(), records.size());
+    writer.writeSection(SECTION_SKILLS, skills.data(), skills.size());
+    writer.writeSection(SECTION_LOADOUTS, loadouts.data(), loadouts.size());
+    writer.writeSection(SECTION_ID_INDEX, sorted.data(), sorted.size());
+
+    // Weapon catalog, in WeaponId order so loadouts and stock stay valid
+    vector<SnapshotWeapon> weapons(weaponCatalog.size());
+    for (WeaponId id = 0; id < weaponCatalog.size(); ++id) {
+        const Weapon& weapon = weaponCatalog.get(id);
+        weapons[id] = { writer.addString(weapon.getName()), writer.addString(weapon.getType(), true),
+                        weapon.getDamageRating(), weapon.getRange(), weapon.getAccuracy(),
+                        static_cast<uint32_t>(weapon.getRequiredAccess()) };
+    }
+    writer.writeSection(SECTION_WEAPONS, weapons.data(), weapons.size());
+
+    vector<SnapshotWarzone> zones;
+    for (const Warzone* warzone : warzones) {
+        zones.push_back({ writer.addString(warzone->getId()), writer.addString(warzone->getName()),
+                          writer.addString(warzone->getLocation()), writer.addString(warzone->getDescription()),
+                          static_cast<uint32_t>(warzone->getRequiredAccess()) });
     }
+    writer.writeSection(SECTION_WARZONES, zones.data(), zones.size());
 
-    string toString() const {
-        return id + ": " + firstName + " " + lastName + " - " + rank.toString();
+    vector<SnapshotWarzoneLimits> limits;
+    vector<SnapshotString> zoneSkills;
+    for (const Warzone* warzone : warzones) {
+        const SkillList& required = warzone->getRequiredSkills();
+        limits.push_back({ warzone->getCapacity(), static_cast<uint32_t>(zoneSkills.size()), static_cast<uint32_t>(required.size()) });
+        for (SkillId skill : required) zoneSkills.push_back(writer.addString(SkillNames::name(skill), true));
     }
+    writer.writeSection(SECTION_WARZONE_LIMITS, limits.data(), limits.size());
+    writer.writeSection(SECTION_WARZONE_SKILLS, zoneSkills.data(), zoneSkills.size());
 
-    string getId() const { return id; }
-    AccessLevel getAccessLevel() const { return rank.getAccessLevel(); }
-    const vector<Weapon>& getWeapons() const { return assignedWeapons; }
-};
+    vector<SnapshotWarzonePosition> positions;
+    for (const Warzone* warzone : warzones) positions.push_back({ warzone->getLatitude(), warzone->getLongitude() });
+    writer.writeSection(SECTION_WARZONE_POSITIONS, positions.data(), positions.size());
 
-// ------------------- Warzone -------------------
-class Warzone : public BaseEntity {
-private:
-    string id, name, location, description;
-    AccessLevel requiredAccessLevel;
-public:
-    Warzone(string i, string n, string loc, string desc, AccessLevel al)
-        : id(i), name(n), location(loc), description(desc), requiredAccessLevel(al) {}
+    vector<uint32_t> deployed(count);
+    for (SoldierHandle h = 0; h < count; ++h) {
+        uint32_t state = deployments.state(h);
+        deployed[h] = (state == DeploymentScheduler::OFF) ? 0 : (state == DeploymentScheduler::WAITING) ? 1 : 2 + state;
+    }
+    writer.writeSection(SECTION_DEPLOYMENTS, deployed.data(), deployed.size());
 
-    bool canAccess(const Soldier* soldier) const { return soldier->canAccess(requiredAccessLevel); }
+    vector<SnapshotStock> stock;
+    inventory.forEachWeapon([&](WeaponId id, int quantity) { stock.push_back({ id, quantity }); });
+    writer.writeSection(SECTION_WEAPON_STOCK, stock.data(), stock.size());
 
-    void displayInfo() const override {
-        cout << "Warzone: " << name << " located at " << location << ", Access Level: " << static_cast<int>(requiredAccessLevel) << endl;
+    vector<SnapshotSupply> supplies;
+    inventory.forEachSupply([&](const string& id, const string& description, int quantity) {
+        supplies.push_back({ writer.addString(id), writer.addString(description), quantity });
+    });
+    writer.writeSection(SECTION_SUPPLIES, supplies.data(), supplies.size());
+
+    // A new epoch ties the journal that follows to this snapshot
+    if (!writer.finish(path, journalEpoch + 1)) return false;
+    ++journalEpoch;
+    if (journal && !journal->reset(journalEpoch)) {
+        cout << "Warning: could not restart the journal.\n";
     }
+    return true;
+}
 
-    string toString() const { return name + " at " + location; }
-};
+// Replaces the current state with a snapshot. Soldiers are served from the mapping;
+// the small catalog, warzone and inventory sections are rebuilt as objects.
+bool MilitaryManagementSystem::loadSnapshot(const string& path) {
+    auto image = make_shared<SnapshotImage>();
+    string error;
+    if (!image->open(path, error)) {
+        cout << "Cannot load snapshot " << path << ": " << error << "\n";
+        return false;
+    }
 
-// ------------------- Inventory -------------------
-class Inventory : public BaseEntity {
-private:
-    map<string, pair<Weapon, int>> weapons;
-    map<string, pair<string, int>> supplies;
-    AccessLevel requiredAccessLevel;
+    // Weapon ids in loadouts and stock must refer to the catalog in the same image
+    uint64_t weaponCount = image->count(SECTION_WEAPONS);
+    const WeaponId* loadouts = image->section<WeaponId>(SECTION_LOADOUTS);
+    WeaponId maxWeapon = 0;
+    for (uint64_t i = 0; i < image->count(SECTION_LOADOUTS); ++i) maxWeapon = max(maxWeapon, loadouts[i]);
+    const SnapshotStock* stock = image->section<SnapshotStock>(SECTION_WEAPON_STOCK);
+    for (uint64_t i = 0; i < image->count(SECTION_WEAPON_STOCK); ++i) maxWeapon = max(maxWeapon, stock[i].weapon);
+    bool anyWeaponRefs = image->count(SECTION_LOADOUTS) + image->count(SECTION_WEAPON_STOCK) > 0;
+    if (anyWeaponRefs && maxWeapon >= weaponCount) {
+        cout << "Cannot load snapshot " << path << ": weapon reference out of range\n";
+        return false;
+    }
 
-public:
-    Inventory(AccessLevel al = AccessLevel::CONFIDENTIAL) : requiredAccessLevel(al) {}
+    weaponCatalog.clear();
+    inventory.clear();
+    warzones.clear();
+    warzoneSlots.clear();
+    warzonePool.clear();
+    deployments.clear();
+    warzoneMap.clear();
+    accessIndex = AccessIndex();
+    accessIndex.addInventory(0, inventory.getRequiredAccess());
 
-    void addWeapon(const Weapon& weapon, int quantity) {
-        string name = weapon.getName();
-        if (weapons.count(name)) {
-            weapons[name].second += quantity;
-        } else {
-            weapons[name] = make_pair(weapon, quantity);
-        }
+    const SnapshotWeapon* weapons = image->section<SnapshotWeapon>(SECTION_WEAPONS);
+    for (uint64_t i = 0; i < weaponCount; ++i) {
+        const SnapshotWeapon& w = weapons[i];
+        Weapon weapon(string(image->str(w.name)), string(image->str(w.type)), w.damageRating, w.range, w.accuracy,
+                      static_cast<AccessLevel>(w.requiredAccess));
+        accessIndex.addWeapon(weaponCatalog.append(weapon), weapon.getRequiredAccess());
     }
 
-    void removeWeapon(const string& weaponName, int quantity) {
-        auto it = weapons.find(weaponName);
-        if (it != weapons.end()) {
-            it->second.second -= quantity;
-            if (it->second.second <= 0) {
-                weapons.erase(it);
+    const SnapshotWarzone* zones = image->section<SnapshotWarzone>(SECTION_WARZONES);
+    const SnapshotWarzoneLimits* limits = image->section<SnapshotWarzoneLimits>(SECTION_WARZONE_LIMITS);
+    const SnapshotString* zoneSkills = image->section<SnapshotString>(SECTION_WARZONE_SKILLS);
+    const SnapshotWarzonePosition* positions = image->section<SnapshotWarzonePosition>(SECTION_WARZONE_POSITIONS);
+    for (uint64_t i = 0; i < image->count(SECTION_WARZONES); ++i) {
+        const SnapshotWarzone& z = zones[i];
+        Warzone warzone(string(image->str(z.id)), string(image->str(z.name)), string(image->str(z.location)),
+                        string(image->str(z.description)), static_cast<AccessLevel>(z.requiredAccess));
+        if (i < image->count(SECTION_WARZONE_LIMITS)) {  // version 4
+            const SnapshotWarzoneLimits& l = limits[i];
+            SkillList required;
+            for (uint32_t k = 0; k < l.skillCount && uint64_t(l.skillsBegin) + k < image->count(SECTION_WARZONE_SKILLS); ++k) {
+                required.push_back(SkillNames::intern(image->str(zoneSkills[l.skillsBegin + k])));
             }
+            warzone.setCapacity(l.capacity);
+            warzone.setRequiredSkills(required);
         }
+        if (i < image->count(SECTION_WARZONE_POSITIONS)) warzone.setPosition(positions[i].latitude, positions[i].longitude);
+        storeWarzone(move(warzone));
     }
 
-    void addSupply(const string& supplyId, const string& description, int quantity) {
-        if (supplies.count(supplyId)) {
-            supplies[supplyId].second += quantity;
-        } else {
-            supplies[supplyId] = make_pair(description, quantity);
-        }
+    for (uint64_t i = 0; i < image->count(SECTION_WEAPON_STOCK); ++i) {
+        inventory.addWeapon(stock[i].weapon, stock[i].quantity);
+    }
+    const SnapshotSupply* supplies = image->section<SnapshotSupply>(SECTION_SUPPLIES);
+    for (uint64_t i = 0; i < image->count(SECTION_SUPPLIES); ++i) {
+        inventory.addSupply(string(image->str(supplies[i].id)), string(image->str(supplies[i].description)), supplies[i].quantity);
     }
 
-    void removeSupply(const string& supplyId, int quantity) {
-        auto it = supplies.find(supplyId);
-        if (it != supplies.end()) {
-            it->second.second -= quantity;
-            if (it->second.second <= 0) {
-                supplies.erase(it);
-            }
+    soldiers.attachSnapshot(image);
+    const uint32_t* deployed = image->section<uint32_t>(SECTION_DEPLOYMENTS);
+    for (uint64_t h = 0; h < image->count(SECTION_DEPLOYMENTS); ++h) {
+        if (deployed[h] == 1) {
+            deployments.setState(static_cast<SoldierHandle>(h), DeploymentScheduler::WAITING);
+        } else if (deployed[h] >= 2 && deployed[h] - 2 < warzones.size()) {
+            deployments.setState(static_cast<SoldierHandle>(h), deployed[h] - 2);
         }
     }
+    journalEpoch = image->journalEpoch();
+    return true;
+}
 
-    int getWeaponQuantity(const string& weaponName) const {
-        auto it = weapons.find(weaponName);
-        return (it != weapons.end()) ? it->second.second : 0;
+// Replays the journal on top of the current state, then logs every further mutation
+bool MilitaryManagementSystem::openJournal(const string& path) {
+    auto opened = make_unique<Journal>();
+    long long replayed = opened->open(path, journalEpoch, [&](JournalOp op, JournalReader& record) {
+        applyJournalRecord(op, record);
+    });
+    if (replayed < 0) {
+        cout << "Cannot open journal " << path << ".\n";
+        return false;
     }
+    journal = move(opened);
+    inventory.attachJournal(journal.get());
+    if (replayed > 0) cout << "Replayed " << replayed << " journal records.\n";
+    return true;
+}
 
-    int getSupplyQuantity(const string& supplyId) const {
-        auto it = supplies.find(supplyId);
-        return (it != supplies.end()) ? it->second.second : 0;
+// Re-applies one logged mutation. The journal is not attached yet, so nothing is re-logged.
+void MilitaryManagementSystem::applyJournalRecord(JournalOp op, JournalReader& record) {
+    switch (op) {
+    case JournalOp::ADD_WEAPON: {
+        WeaponId weapon = record.u32();
+        int32_t quantity = record.i32();
+        if (record.ok() && weapon < weaponCatalog.size()) inventory.addWeapon(weapon, quantity);
+        break;
     }
-
-    bool canAccess(const Soldier* soldier) const {
-        return static_cast<int>(soldier->getAccessLevel()) >= static_cast<int>(requiredAccessLevel);
+    case JournalOp::REMOVE_WEAPON: {
+        WeaponId weapon = record.u32();
+        int32_t quantity = record.i32();
+        if (record.ok()) inventory.removeWeapon(weapon, quantity);
+        break;
     }
-
-    void displayInfo() const override {
-        cout << "Inventory Access Level: " << static_cast<int>(requiredAccessLevel) << endl;
-        cout << "Weapons:\n";
-        for (const auto& [name, pair] : weapons) {
-            cout << "- " << name << " x" << pair.second << "\n";
+    case JournalOp::ADD_SUPPLY: {
+        string id = record.str(), description = record.str();
+        int32_t quantity = record.i32();
+        if (record.ok()) inventory.addSupply(id, description, quantity);
+        break;
+    }
+    case JournalOp::REMOVE_SUPPLY: {
+        string id = record.str();
+        int32_t quantity = record.i32();
+        if (record.ok()) inventory.removeSupply(id, quantity);
+        break;
+    }
+    case JournalOp::ASSIGN_WEAPON: {
+        string soldierId = record.str();
+        WeaponId weapon = record.u32();
+        SoldierHandle h = soldiers.find(soldierId);
+        if (record.ok() && h != SoldierStore::npos && weapon < weaponCatalog.size()) soldiers.get(h).assignWeapon(weapon);
+        break;
+    }
+    case JournalOp::CREATE_SOLDIER: {
+        string id = record.str(), firstName = record.str(), lastName = record.str(), rankName = record.str();
+        int32_t rankLevel = record.i32();
+        uint32_t access = record.u32(), branch = record.u32();
+        string specialization = record.str();
+        int32_t experience = record.i32();
+        if (record.ok() && isValidAccessLevel(static_cast<int>(access)) && isValidBranch(static_cast<int>(branch))) {
+            MilitaryRank rank(rankName, rankLevel, static_cast<AccessLevel>(access), static_cast<MilitaryBranch>(branch));
+            soldiers.add(Soldier(id, firstName, lastName, rank, specialization, experience));
         }
-        cout << "Supplies:\n";
-        for (const auto& [id, pair] : supplies) {
-            cout << "- " << id << ": " << pair.first << " x" << pair.second << "\n";
+        break;
+    }
+    case JournalOp::DEFINE_WEAPON: {
+        WeaponId expected = record.u32();
+        string name = record.str(), type = record.str();
+        int32_t damage = record.i32(), range = record.i32(), accuracy = record.i32();
+        uint32_t access = record.u32();
+        if (record.ok() && isValidAccessLevel(static_cast<int>(access)) &&
+            addWeaponType(Weapon(name, type, damage, range, accuracy, static_cast<AccessLevel>(access))) != expected) {
+            cout << "Warning: journal weapon " << name << " replayed under a different id.\n";
         }
+        break;
     }
-
-    string toString() const {
-        string result = "Inventory:\nWeapons:\n";
-        for (const auto& [name, pair] : weapons) {
-            result += "- " + name + " x" + to_string(pair.second) + "\n";
+    case JournalOp::ADD_WARZONE: {
+        string id = record.str(), name = record.str(), location = record.str(), description = record.str();
+        uint32_t access = record.u32();
+        if (record.ok() && isValidAccessLevel(static_cast<int>(access))) {
+            addWarzone(Warzone(id, name, location, description, static_cast<AccessLevel>(access)));
         }
-        result += "Supplies:\n";
-        for (const auto& [id, pair] : supplies) {
-            result += "- " + id + ": " + pair.first + " x" + to_string(pair.second) + "\n";
+        break;
+    }
+    case JournalOp::ADD_SKILL: {
+        string soldierId = record.str(), skill = record.str();
+        SoldierHandle h = soldiers.find(soldierId);
+        if (record.ok() && h != SoldierStore::npos) soldiers.get(h).addSkill(skill);
+        break;
+    }
+    case JournalOp::ASSIGN_UNIT: {
+        string soldierId = record.str(), unitName = record.str();
+        SoldierHandle h = soldiers.find(soldierId);
+        if (record.ok() && h != SoldierStore::npos) soldiers.setUnit(h, soldiers.internUnit(unitName));
+        break;
+    }
+    case JournalOp::PROMOTE: {
+        string soldierId = record.str(), rankName = record.str();
+        int32_t rankLevel = record.i32();
+        SoldierHandle h = soldiers.find(soldierId);
+        if (record.ok() && h != SoldierStore::npos && isValidRankLevel(rankLevel)) soldiers.promote(h, rankName, rankLevel);
+        break;
+    }
+    case JournalOp::WARZONE_LIMITS: {
+        string warzoneId = record.str();
+        uint32_t capacity = record.u32();
+        string skills = record.str();
+        auto it = warzoneSlots.find(warzoneId);
+        if (record.ok() && it != warzoneSlots.end()) {
+            Warzone warzone = *warzones[it->second];
+            warzone.setCapacity(capacity);
+            warzone.setRequiredSkills(parseSkillList(skills));
+            storeWarzone(move(warzone));
+        }
+        break;
+    }
+    case JournalOp::DEPLOY: {
+        string soldierId = record.str();
+        uint32_t kind = record.u32();
+        string warzoneId = record.str();
+        SoldierHandle h = soldiers.find(soldierId);
+        auto it = warzoneSlots.find(warzoneId);
+        if (!record.ok() || h == SoldierStore::npos) break;
+        if (kind == 0) {
+            deployments.setState(h, DeploymentScheduler::OFF);
+        } else if (kind == 1) {
+            deployments.setState(h, DeploymentScheduler::WAITING);
+        } else if (it != warzoneSlots.end()) {
+            deployments.setState(h, static_cast<uint32_t>(it->second));
+        }
+        break;
+    }
+    case JournalOp::WARZONE_POSITION: {
+        string warzoneId = record.str();
+        double latitude = record.f64(), longitude = record.f64();
+        auto it = warzoneSlots.find(warzoneId);
+        if (record.ok() && it != warzoneSlots.end()) {
+            Warzone warzone = *warzones[it->second];
+            warzone.setPosition(latitude, longitude);
+            storeWarzone(move(warzone));
         }
+        break;
+    }
+    }
+}
+
+// Streams the file in IMPORT_CHUNK_SIZE blocks cut at line boundaries. Blocks are parsed
+// and validated on worker threads while this thread applies finished blocks in file
+// order, so later lines still win over earlier ones with the same ID. At most two blocks
+// per core are in flight, which bounds memory regardless of file size. Files ending in
+// .jsonl/.ndjson/.json are read as JSON lines, anything else as CSV.
+MilitaryManagementSystem::ImportResult MilitaryManagementSystem::importFile(const string& path) {
+    ImportResult result;
+    ifstream file(path, ios::binary);
+    if (!file) {
+        cout << "Cannot open import file " << path << ".\n";
         return result;
     }
-};
+    result.opened = true;
+    auto endsWith = [&](const char* suffix) {
+        size_t n = strlen(suffix);
+        return path.size() >= n && path.compare(path.size() - n, n, suffix) == 0;
+    };
+    bool json = endsWith(".jsonl") || endsWith(".ndjson") || endsWith(".json");
+    size_t maxInFlight = 2 * max(1u, thread::hardware_concurrency());
 
-// ------------------- MilitaryManagementSystem -------------------
-class MilitaryManagementSystem {
-private:
-    map<string, unique_ptr<Soldier>> soldiers;
-    map<string, Weapon> weaponTypes;
-    map<string, Warzone*> warzones;
-    Soldier* currentUser;
-    Inventory inventory;
+    deque<future<ImportChunk>> inFlight;
+    size_t lineBase = 0;
+    auto applyOldest = [&] {
+        ImportChunk chunk = inFlight.front().get();
+        inFlight.pop_front();
+        for (ImportedWeapon& w : chunk.weapons) {
+            WeaponId id = addWeaponType(w.weapon);
+            if (w.quantity > 0) inventory.addWeapon(id, w.quantity);
+        }
+        for (Warzone& z : chunk.warzones) {
+            if (journal) {
+                journal->append(JournalOp::ADD_WARZONE, z.getId(), z.getName(), z.getLocation(), z.getDescription(),
+                                static_cast<uint32_t>(z.getRequiredAccess()));
+                if (z.hasPosition()) journal->append(JournalOp::WARZONE_POSITION, z.getId(), z.getLatitude(), z.getLongitude());
+            }
+            addWarzone(move(z));
+        }
+        if (!chunk.warzones.empty()) rebalanceDeployments();
+        soldiers.reserve(chunk.soldiers.size());
+        for (Soldier& soldier : chunk.soldiers) addSoldier(move(soldier));
+        for (const auto& [line, message] : chunk.errors) {
+            if (result.rejected++ < IMPORT_MAX_ERRORS_SHOWN) cout << path << ":" << lineBase + line << ": " << message << "\n";
+        }
+        result.soldiers += chunk.soldiers.size();
+        result.weapons += chunk.weapons.size();
+        result.warzones += chunk.warzones.size();
+        lineBase += chunk.lines;
+        commitJournal();  // keeps the journal's pending buffer bounded too
+    };
 
-public:
-    MilitaryManagementSystem();
-    ~MilitaryManagementSystem();
-    bool login(string soldierId);
-    void logout();
-    void run();
-    void showHelp();
-    void showRankInfo();
-    void showBranchInfo();
-    void showAccessLevelInfo();
-    MilitaryRank createRank();
-    Soldier* createSoldier();
-    void addWeaponManually();
-    void addWarzoneManually();
-    void addDefaultWeaponsAndWarzones();
-    void assignWeaponToSoldier();
-    void assignWarzoneToSoldier();
-    void displaySoldierInfo();
-};
+    string carry;  // partial last line of the previous block
+    while (file) {
+        string block = move(carry);
+        carry.clear();
+        size_t used = block.size();
+        block.resize(used + IMPORT_CHUNK_SIZE);
+        file.read(&block[used], IMPORT_CHUNK_SIZE);
+        block.resize(used + static_cast<size_t>(file.gcount()));
+        if (file) {
+            size_t lastNewline = block.rfind('\n');
+            if (lastNewline == string::npos) {  // a single line longer than the block
+                carry = move(block);
+                continue;
+            }
+            carry.assign(block, lastNewline + 1, string::npos);
+            block.resize(lastNewline + 1);
+        }
+        if (block.empty()) continue;
+        if (inFlight.size() >= maxInFlight) applyOldest();
+        inFlight.push_back(async(launch::async, [text = move(block), json] { return parseImportChunk(text, json); }));
+    }
+    while (!inFlight.empty()) applyOldest();
+    if (result.rejected > IMPORT_MAX_ERRORS_SHOWN) {
+        cout << "(" << result.rejected - IMPORT_MAX_ERRORS_SHOWN << " more errors not shown)\n";
+    }
+    return result;
+}
 
-MilitaryManagementSystem::MilitaryManagementSystem() : currentUser(nullptr) {
-    addDefaultWeaponsAndWarzones();
+// Makes every logged mutation durable (one fsync for the whole pending group)
+bool MilitaryManagementSystem::commitJournal() {
+    if (syncJournal()) return true;
+    cout << "Warning: journal write failed; changes since the last successful commit are not durable and no further "
+            "changes are logged until save_snapshot succeeds.\n";
+    return false;
 }
 
-MilitaryManagementSystem::~MilitaryManagementSystem() {
-    for (auto& pair : warzones) delete pair.second;
+
+bool MilitaryManagementSystem::loginCommand() {
+    if (currentUser()) {
+        cout << "A soldier is already logged in. Please logout first.\n";
+        return false;
+    }
+    string soldierId;
+    prompt("Enter Soldier ID to login: ");
+    *in >> soldierId;
+    if (!argumentsOk()) return false;
+    if (!login(soldierId)) {
+        cout << "Soldier not found.\n";
+        return false;
+    }
+    cout << "Logged in successfully.\n";
+    return true;
 }
 
-bool MilitaryManagementSystem::login(string soldierId) {
-    auto it = soldiers.find(soldierId);
-    if (it != soldiers.end()) {
-        currentUser = it->second.get();
-        return true;
+bool MilitaryManagementSystem::logoutCommand() {
+    if (!currentUser()) {
+        cout << "No soldier is currently logged in.\n";
+        return false;
     }
-    return false;
+    logout();
+    return true;
 }
 
-void MilitaryManagementSystem::logout() {
-    currentUser = nullptr;
-    cout << "Logged out successfully.\n";
+bool MilitaryManagementSystem::createSoldierCommand() {
+    return createSoldier() != nullptr;
 }
 
-void MilitaryManagementSystem::showHelp() {
-    cout << "\n--- Military Management System Commands ---\n";
-    cout << "login - Log in with Soldier ID\n";
-    cout << "create_soldier - Create a new soldier\n";
-    cout << "create_rank - Create a new rank\n";
-    cout << "add_weapon - Add a new weapon manually\n";
-    cout << "add_warzone - Add a new warzone manually\n";
-    cout << "assign_weapon - Assign a weapon to the logged-in soldier\n";
-    cout << "assign_warzone - Assign a warzone to the logged-in soldier\n";
-    cout << "display_soldier - Display the information of the logged-in soldier\n";
-    cout << "view_inventory - View current inventory status (based on access level)\n";
-    
-    if (currentUser) {  // Only show logout option if logged in
-        cout << "logout - Log out from the system\n";
+bool MilitaryManagementSystem::viewInventory() {
+    if (!currentUser()) {
+        cout << "No soldier logged in.\n";
+        return false;
     }
-
-    cout << "exit - Exit the system\n\n";
+    if (!inventoryCleared()) {
+        cout << "Access denied to inventory.\n";
+        return false;
+    }
+    inventory.displayInfo();
+    return true;
 }
 
-
-void MilitaryManagementSystem::showRankInfo() {
-    cout << "\n--- Available Rank Levels ---\n";
-    cout << "1-10: Enlisted\n";
-    cout << "11-20: Officers\n\n";
+bool MilitaryManagementSystem::saveSnapshotCommand() {
+    string path;
+    prompt("Enter snapshot file: ");
+    *in >> path;
+    if (!argumentsOk() || !servedLocally("save_snapshot")) return false;
+    if (!saveSnapshot(path)) {
+        cout << "Failed to write snapshot " << path << ".\n";
+        return false;
+    }
+    cout << "Snapshot saved to " << path << ".\n";
+    return true;
 }
 
-void MilitaryManagementSystem::showBranchInfo() {
-    cout << "\n--- Available Military Branches ---\n";
-    cout << "1: ARMY\n2: NAVY\n3: AIR_FORCE\n4: MARINES\n5: COAST_GUARD\n6: SPACE_FORCE\n\n";
+bool MilitaryManagementSystem::loadSnapshotCommand() {
+    string path;
+    prompt("Enter snapshot file: ");
+    *in >> path;
+    if (!argumentsOk() || !servedLocally("load_snapshot")) return false;
+    if (!loadSnapshot(path)) return false;
+    cout << "Snapshot loaded from " << path << ".\n";
+    return true;
 }
 
-void MilitaryManagementSystem::showAccessLevelInfo() {
-    cout << "\n--- Available Access Levels ---\n";
-    cout << "1: CONFIDENTIAL\n2: SECRET\n3: TOP_SECRET\n4: SCI\n\n";
+bool MilitaryManagementSystem::importCommand() {
+    string path;
+    prompt("Enter import file (.csv or .jsonl): ");
+    *in >> path;
+    if (!argumentsOk() || !servedLocally("import")) return false;
+    auto start = chrono::steady_clock::now();
+    ImportResult result = importFile(path);
+    if (!result.opened) return false;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Imported " << result.soldiers << " soldiers, " << result.weapons << " weapons and " << result.warzones
+         << " warzones from " << path << " in " << seconds << " s";
+    if (result.rejected) cout << " (" << result.rejected << " lines rejected)";
+    cout << ".\n";
+    return result.rejected == 0;
 }
 
+// Lets a subsystem add a command without touching the dispatch loop. The handler reads
+// its arguments from the current input like the built-ins do.
+bool MilitaryManagementSystem::registerCommand(const string& name, const string& help, function<bool()> handler) {
+    return commands.add(name, help, move(handler));
+}
 
-MilitaryRank MilitaryManagementSystem::createRank() {
-    showRankInfo(); showAccessLevelInfo(); showBranchInfo();
-    
-    string name;
-    int rankLevel, accessLevel, branch;
+// Looks the command up in the command table, runs it and records its latency and
+// outcome. Returns false if the command failed, so batch runs can count failures.
+// Time spent waiting at the console for arguments is not counted.
+bool MilitaryManagementSystem::dispatch(const string& command) {
+    auto start = chrono::steady_clock::now();
+    uint64_t waitedBefore = inputClock ? inputClock->waited() : 0;
+    CommandTable::Entry* entry = commands.find(command);
+    bool ok = false;
+    if (entry) {
+        ok = entry->handler();
+    } else {
+        cout << "Unknown command.\n";
+    }
+    uint64_t ns = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    if (inputClock) ns -= min(ns, inputClock->waited() - waitedBefore);
+    (entry ? entry->latency : unknownCommandLatency).record(ns, ok);
+    if (entry) session->record(entry->index, ok);
+    return ok;
+}
 
-    cout << "Enter Rank Name: "; cin >> name;
-    cout << "Enter Rank Level: "; cin >> rankLevel;
-    cout << "Enter Access Level: "; cin >> accessLevel;
-    cout << "Enter Branch (1-6): "; cin >> branch;
+bool MilitaryManagementSystem::historyCommand() {
+    const deque<CommandTable::Entry>& entries = commands.all();
+    uint32_t now = static_cast<uint32_t>(time(nullptr));
+    ReportWriter out(cout);
+    session->forEachHistory([&](const Session::HistoryEntry& entry) {
+        out << entries[entry.command].name << (entry.ok ? "" : " (failed)") << ", " << now - entry.time << "s ago\n";
+    });
+    return true;
+}
 
-    return MilitaryRank(name, rankLevel, static_cast<AccessLevel>(accessLevel), static_cast<MilitaryBranch>(branch));
+bool MilitaryManagementSystem::showStats() {
+    char line[128];
+    cout << "\n--- Command Latency (microseconds) ---\n";
+    snprintf(line, sizeof(line), "%-16s %10s %8s %10s %10s %10s %10s\n", "command", "count", "errors", "p50", "p99", "p999", "max");
+    cout << line;
+    vector<pair<string, const LatencyHistogram*>> rows;
+    for (const CommandTable::Entry& entry : commands.all()) {
+        if (entry.latency.count()) rows.emplace_back(entry.name, &entry.latency);
+    }
+    if (unknownCommandLatency.count()) rows.emplace_back("(unknown)", &unknownCommandLatency);
+    sort(rows.begin(), rows.end());
+    for (const auto& [name, histogram] : rows) {
+        const LatencyHistogram& h = *histogram;
+        snprintf(line, sizeof(line), "%-16s %10llu %8llu %10.1f %10.1f %10.1f %10.1f\n", name.c_str(),
+                 static_cast<unsigned long long>(h.count()), static_cast<unsigned long long>(h.errorCount()),
+                 h.percentile(0.5) / 1e3, h.percentile(0.99) / 1e3, h.percentile(0.999) / 1e3, h.max() / 1e3);
+        cout << line;
+    }
+    return true;
 }
 
-Soldier* MilitaryManagementSystem::createSoldier() {
-    string soldierId, firstName, lastName, specialization;
-    int experience;
-    MilitaryRank rank = createRank();
-    
-    cout << "Enter Soldier ID: "; cin >> soldierId;
-    cout << "Enter First Name: "; cin >> firstName;
-    cout << "Enter Last Name: "; cin >> lastName;
-    cout << "Enter Specialization: "; cin >> specialization;
-    cout << "Enter Years of Experience: "; cin >> experience;
-    
-    auto soldier = make_unique<Soldier>(soldierId, firstName, lastName, rank, specialization, experience);
-    soldiers[soldierId] = move(soldier); // Store soldier in map
-    return soldiers[soldierId].get();
+// Writes one JSON object per command that has run
+bool MilitaryManagementSystem::writeStats(const string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    vector<pair<string, const LatencyHistogram*>> rows;
+    for (const CommandTable::Entry& entry : commands.all()) rows.emplace_back(entry.name, &entry.latency);
+    rows.emplace_back("(unknown)", &unknownCommandLatency);
+    for (const auto& [name, h] : rows) {
+        if (!h->count()) continue;
+        fprintf(file, "{\"command\":\"%s\",\"count\":%llu,\"errors\":%llu,\"mean_ns\":%llu,\"p50_ns\":%llu,"
+                      "\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+                name.c_str(), static_cast<unsigned long long>(h->count()), static_cast<unsigned long long>(h->errorCount()),
+                static_cast<unsigned long long>(h->mean()), static_cast<unsigned long long>(h->percentile(0.5)),
+                static_cast<unsigned long long>(h->percentile(0.99)), static_cast<unsigned long long>(h->percentile(0.999)),
+                static_cast<unsigned long long>(h->max()));
+    }
+    return fclose(file) == 0;
 }
 
-void MilitaryManagementSystem::addWeaponManually() {
-    string name, type;
-    int damageRating, range, accuracy, accessLevel;
-
-    cout << "Enter weapon name: ";
-    cin >> name;
-    cout << "Enter type: ";
-    cin >> type;
-    cout << "Enter damage rating: ";
-    cin >> damageRating;
-    cout << "Enter range: ";
-    cin >> range;
-    cout << "Enter accuracy: ";
-    cin >> accuracy;
-    cout << "Enter access level (0=LOW, 1=MEDIUM, 2=HIGH): ";
-    cin >> accessLevel;
-
-    Weapon newWeapon(name, type, damageRating, range, accuracy, static_cast<AccessLevel>(accessLevel));
-    weaponTypes[name] = newWeapon;
+void MilitaryManagementSystem::run() {
+    InputClock clock(in->rdbuf());
+    streambuf* console = in->rdbuf(&clock);
+    inputClock = &clock;
+    string command;
+    while (true) {
+        if (Soldier* user = currentUser()) {
+            cout << "\n[Logged in as: " << user->getId() << "]\n";
+        } else {
+            cout << "\n[No soldier logged in]\n";
+        }
 
-    int quantity;
-    cout << "Enter quantity to add to inventory: ";
-    cin >> quantity;
-    inventory.addWeapon(newWeapon, quantity); // 🔥 ADDED THIS LINE
+        cout << "Enter command (type 'help' for available commands): ";
+        if (!(*in >> command)) break;
 
-    cout << "Weapon added successfully.\n";
+        if (command == "exit") {
+            cout << "Exiting system...\n";
+            break;
+        }
+        dispatch(command);
+        commitJournal();
+        if (in->fail() && !in->eof()) {  // skip the rest of a malformed line
+            in->clear();
+            in->ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+    }
+    inputClock = nullptr;
+    in->rdbuf(console);
 }
 
+// Runs a script non-interactively: one command and its arguments per line, no prompts.
+// Blank lines and lines starting with '#' are skipped, and 'exit' ends the script early.
+MilitaryManagementSystem::BatchResult MilitaryManagementSystem::runBatch(istream& script) {
+    BatchResult result;
+    istream* previousIn = in;
+    bool wasInteractive = interactive;
+    interactive = false;
 
+    string line, command;
+    istringstream args;  // reused for every line
+    while (getline(script, line)) {
+        args.clear();
+        args.str(line);
+        if (!(args >> command) || command[0] == '#') continue;
+        if (command == "exit") break;
+        in = &args;
+        if (dispatch(command)) {
+            ++result.succeeded;
+        } else {
+            ++result.failed;
+        }
+        if (journal && journal->pendingRecords() >= JOURNAL_GROUP_SIZE) commitJournal();
+    }
+    commitJournal();
 
-void MilitaryManagementSystem::addWarzoneManually() {
-    string id, name, location, description;
-    int accessLevel;
-    cout << "Enter warzone ID: "; cin >> id;
-    cout << "Enter warzone name: "; cin >> name;
-    cout << "Enter warzone location: "; cin >> location;
-    cout << "Enter warzone description: "; cin >> description;
-    cout << "Enter required access level (1-4): "; cin >> accessLevel;
-    warzones[id] = new Warzone(id, name, location, description, static_cast<AccessLevel>(accessLevel));
+    in = previousIn;
+    interactive = wasInteractive;
+    return result;
 }
 
-void MilitaryManagementSystem::addDefaultWeaponsAndWarzones() {
-    weaponTypes["Rifle"] = Weapon("Rifle", "Assault", 50, 300, 70, AccessLevel::CONFIDENTIAL);
-    weaponTypes["Pistol"] = Weapon("Pistol", "Sidearm", 30, 100, 80, AccessLevel::SECRET);
-    weaponTypes["Sniper"] = Weapon("Sniper", "Precision", 100, 600, 90, AccessLevel::TOP_SECRET);
-    
-    warzones["Z1"] = new Warzone("Z1", "Desert Storm", "Middle East", "Tense desert combat zone.", AccessLevel::TOP_SECRET);
-    warzones["Z2"] = new Warzone("Z2", "Arctic Warfare", "Northern Region", "Cold and hazardous environment.", AccessLevel::SECRET);
+// Runs one command line in a client's session and captures what it prints. Not
+// thread-safe: the caller serializes calls.
+bool MilitaryManagementSystem::executeLine(const string& line, Session& client, string& output) {
+    istringstream args(line);
+    string command;
+    output.clear();
+    if (!(args >> command) || command[0] == '#') return true;
+
+    session = &client;
+    istream* previousIn = in;
+    bool wasInteractive = interactive;
+    in = &args;
+    interactive = false;
+    ostringstream captured;
+    streambuf* console = cout.rdbuf(captured.rdbuf());
+
+    bool ok = dispatch(command);
+
+    cout.rdbuf(console);
+    in = previousIn;
+    interactive = wasInteractive;
+    session = &consoleSession;
+    output = captured.str();
+    return ok;
 }
 
-void MilitaryManagementSystem::assignWeaponToSoldier() {
-    string soldierId, weaponName;
-    cout << "Enter Soldier ID: "; cin >> soldierId;
-    cout << "Enter Weapon Name: "; cin >> weaponName;
-    
-    auto soldierIt = soldiers.find(soldierId);
-    if (soldierIt != soldiers.end() && weaponTypes.find(weaponName) != weaponTypes.end()) {
-        Soldier* soldier = soldierIt->second.get();
-        Weapon weapon = weaponTypes[weaponName];
-        
-        if (soldier->canAccess(weapon.getRequiredAccess())) {
-            soldier->assignWeapon(weapon);
-            cout << "Weapon assigned successfully.\n";
-        } else {
-            cout << "Insufficient access level to assign this weapon.\n";
+// ------------------- CommandServer -------------------
+// Serves the command set to many clients over a Unix domain socket. Each request is one
+// command line ("login S1\n"); each response is a header line "OK <bytes>" or
+// "ERR <bytes>" followed by exactly that many bytes of command output. Clients may
+// pipeline requests; responses come back in order.
+//
+// One thread runs the epoll loop: it accepts connections and hands every connection that
+// has input to the worker pool. Connections are registered one-shot, so a connection is
+// owned by at most one worker at a time; its turn mutex is never contended and only lets
+// ThreadSanitizer see the hand-off, which it cannot follow through epoll. Workers read,
+// frame and answer requests; commands themselves run one at a time under stateLock since
+// the system is not thread-safe. Commands whose work grows with the whole force or with a
+// file are refused to clients (see servedLocally), so what is left is short and a busy
+// client cannot hold the lock for long. A worker answers at most MAX_REQUESTS_PER_TURN requests before giving
+// the connection back, which keeps one pipelining client from starving the others.
+// Journal commits happen outside the lock, so concurrent clients share fsyncs.
+#ifndef _WIN32
+class CommandServer {
+public:
+    CommandServer(MilitaryManagementSystem& system, size_t workerCount)
+        : system(system), workerCount(max<size_t>(1, workerCount)) {}
+
+    // Listens on 'path' and serves until SIGINT/SIGTERM; false if the socket cannot be set up
+    bool run(const string& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            cerr << "Socket path too long: " << path << "\n";
+            return false;
         }
-    } else {
-        cout << "Soldier or weapon not found.\n";
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(path.c_str());  // a stale socket from an earlier run
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listener, SOMAXCONN) != 0) {
+            cerr << "Cannot listen on " << path << ": " << strerror(errno) << "\n";
+            if (listener >= 0) ::close(listener);
+            return false;
+        }
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        watch(listener, EPOLLIN, EPOLL_CTL_ADD, nullptr);
+        watch(wakeFd, EPOLLIN, EPOLL_CTL_ADD, &wakeFd);
+        stopFd = wakeFd;
+        signal(SIGINT, requestStop);
+        signal(SIGTERM, requestStop);
+        signal(SIGPIPE, SIG_IGN);  // a client that hangs up mid-response is handled via EPIPE
+
+        vector<thread> workers;
+        for (size_t i = 0; i < workerCount; ++i) workers.emplace_back([this] { workerLoop(); });
+        cout << "Serving on " << path << " with " << workerCount << " workers.\n" << flush;
+
+        epoll_event events[256];
+        bool running = true;
+        while (running) {
+            int n = epoll_wait(epollFd, events, 256, -1);
+            if (n < 0 && errno != EINTR) break;
+            for (int i = 0; i < n; ++i) {
+                void* tag = events[i].data.ptr;
+                if (tag == nullptr) {
+                    acceptAll();
+                } else if (tag == &wakeFd) {
+                    running = false;
+                } else {
+                    enqueue(static_cast<Connection*>(tag));
+                }
+            }
+        }
+        // Later signals see -1. The handler that woke us has already written; reading its
+        // count orders that write before wakeFd is closed below.
+        stopFd = -1;
+        uint64_t signals;
+        ssize_t ignored = read(wakeFd, &signals, sizeof(signals));
+        (void)ignored;
+
+        {
+            lock_guard<mutex> guard(queueLock);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (thread& worker : workers) worker.join();
+        for (Connection* connection : connections) {
+            ::close(connection->fd);
+            delete connection;
+        }
+        connections.clear();
+        ::close(listener);
+        ::close(epollFd);
+        ::close(wakeFd);
+        unlink(path.c_str());
+        cout << "Server stopped.\n";
+        return true;
     }
-}
 
-void MilitaryManagementSystem::assignWarzoneToSoldier() {
-    string soldierId, warzoneId;
-    cout << "Enter Soldier ID: "; cin >> soldierId;
-    cout << "Enter Warzone ID: "; cin >> warzoneId;
-    
-    auto soldierIt = soldiers.find(soldierId);
-    if (soldierIt != soldiers.end() && warzones.find(warzoneId) != warzones.end()) {
-        Soldier* soldier = soldierIt->second.get();
-        Warzone* warzone = warzones[warzoneId];
-        
-        if (warzone->canAccess(soldier)) {
-            cout << "Warzone assigned to soldier.\n";
-        } else {
-            cout << "Insufficient access level to assign to this warzone.\n";
+private:
+    static const size_t MAX_REQUEST_BYTES = 64 * 1024;
+    static const size_t MAX_REQUESTS_PER_TURN = 32;
+    static const size_t MAX_PENDING_OUTPUT = 1 << 20;  // a client that does not read is not served further
+
+    struct Connection {
+        int fd;
+        string input;         // bytes read but not yet handled
+        string output;        // responses not yet written
+        size_t written = 0;   // bytes of 'output' already sent
+        Session session;
+        bool closing = false; // close once 'output' is flushed
+        mutex turn;           // held by the worker serving it
+    };
+
+    MilitaryManagementSystem& system;
+    size_t workerCount;
+    int listener = -1, epollFd = -1, wakeFd = -1;
+    mutex stateLock;                         // serializes commands against the shared system
+    mutex queueLock;                         // guards the fields below
+    condition_variable queueReady;
+    deque<Connection*> ready;
+    bool stopping = false;
+    unordered_set<Connection*> connections;  // every open connection, for shutdown
+
+    static atomic<int> stopFd;  // lock-free, so the handler may use it on any thread
+
+    static void requestStop(int) {
+        int fd = stopFd.load();
+        if (fd >= 0) {
+            uint64_t one = 1;
+            ssize_t ignored = write(fd, &one, sizeof(one));
+            (void)ignored;
         }
-    } else {
-        cout << "Soldier or warzone not found.\n";
     }
-}
 
+    void watch(int fd, uint32_t events, int operation, void* tag) {
+        epoll_event event{};
+        event.events = events;
+        event.data.ptr = tag;
+        epoll_ctl(epollFd, operation, fd, &event);
+    }
 
-void MilitaryManagementSystem::displaySoldierInfo() {
-    if (currentUser) {
-        currentUser->displayInfo();
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;  // EAGAIN, or out of descriptors until someone disconnects
+            Connection* connection = new Connection();
+            connection->fd = fd;
+            {
+                lock_guard<mutex> guard(queueLock);
+                connections.insert(connection);
+            }
+            watch(fd, EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, EPOLL_CTL_ADD, connection);
+        }
+    }
 
-        // Show assigned weapons
-        const auto& weapons = currentUser->getWeapons();
-        if (!weapons.empty()) {
-            cout << "Assigned Weapons:\n";
-            for (const auto& weapon : weapons) {
-                cout << "- " << weapon << "\n";
+    void enqueue(Connection* connection) {
+        {
+            lock_guard<mutex> guard(queueLock);
+            ready.push_back(connection);
+        }
+        queueReady.notify_one();
+    }
+
+    void workerLoop() {
+        string output;
+        while (true) {
+            Connection* connection;
+            {
+                unique_lock<mutex> guard(queueLock);
+                queueReady.wait(guard, [&] { return stopping || !ready.empty(); });
+                if (stopping) return;
+                connection = ready.front();
+                ready.pop_front();
+            }
+            serve(*connection, output);
+        }
+    }
+
+    // Handles whatever the connection has ready, then re-arms it, re-queues it (more
+    // buffered requests) or closes it. While more than MAX_PENDING_OUTPUT bytes of
+    // answers are unsent, nothing more is read or run and only writability is watched.
+    void serve(Connection& connection, string& output) {
+        bool open = true, flushed, more, failed, closing, backlogged;
+        {
+            lock_guard<mutex> turn(connection.turn);
+            flushed = writePending(connection);
+            if (flushed || pending(connection) <= MAX_PENDING_OUTPUT) open = readAvailable(connection);
+
+            size_t handled = 0, consumed = 0, newline;
+            while (handled < MAX_REQUESTS_PER_TURN && !connection.closing && pending(connection) <= MAX_PENDING_OUTPUT &&
+                   (newline = connection.input.find('\n', consumed)) != string::npos) {
+                string line = connection.input.substr(consumed, newline - consumed);
+                consumed = newline + 1;
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line == "exit") {
+                    connection.closing = true;
+                    break;
+                }
+                bool ok;
+                {
+                    lock_guard<mutex> guard(stateLock);
+                    ok = system.executeLine(line, connection.session, output);
+                }
+                respond(connection, ok, output);
+                ++handled;
+            }
+            connection.input.erase(0, consumed);
+            if (connection.input.size() > MAX_REQUEST_BYTES && connection.input.find('\n') == string::npos) {
+                respond(connection, false, "Request too long.\n");
+                connection.closing = true;
             }
+            if (handled && !system.syncJournal()) cerr << "Warning: journal write failed; recent changes are not durable.\n";
+
+            // A client that has stopped sending still gets answers to everything it sent
+            flushed = writePending(connection);
+            more = !connection.closing && connection.input.find('\n') != string::npos;
+            failed = connection.written == SIZE_MAX;
+            closing = connection.closing;
+            backlogged = !failed && pending(connection) > MAX_PENDING_OUTPUT;
+        }
+        if (failed || (flushed && !more && (closing || !open))) {
+            close(connection);
+        } else if (flushed && more) {
+            enqueue(&connection);  // requests are already buffered; epoll would not report them
         } else {
-            cout << "No weapons assigned.\n";
+            uint32_t events = EPOLLONESHOT;
+            if (!flushed) events |= EPOLLOUT;
+            if (open && !closing && !backlogged) events |= EPOLLIN | EPOLLRDHUP;
+            watch(connection.fd, events, EPOLL_CTL_MOD, &connection);
         }
+    }
 
-        // Show accessible warzones
-        cout << "Accessible Warzones:\n";
-        bool hasAccess = false;
-        for (const auto& [id, warzone] : warzones) {
-            if (warzone->canAccess(currentUser)) {
-                cout << "- " << warzone->toString() << "\n";
-                hasAccess = true;
+    // Unsent answer bytes; a failed connection counts as full so nothing more is run for it
+    static size_t pending(const Connection& connection) {
+        return connection.written == SIZE_MAX ? SIZE_MAX : connection.output.size() - connection.written;
+    }
+
+    // Reads until the socket is drained; false once the peer has closed or failed
+    bool readAvailable(Connection& connection) {
+        char buffer[16384];
+        while (connection.input.size() <= 2 * MAX_REQUEST_BYTES) {
+            ssize_t n = read(connection.fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                connection.input.append(buffer, static_cast<size_t>(n));
+            } else if (n == 0) {
+                return false;
+            } else {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
             }
         }
-        if (!hasAccess) {
-            cout << "No accessible warzones.\n";
+        return true;  // let buffered requests drain first
+    }
+
+    void respond(Connection& connection, bool ok, const string& body) {
+        char header[32];
+        int length = snprintf(header, sizeof(header), "%s %zu\n", ok ? "OK" : "ERR", body.size());
+        connection.output.append(header, static_cast<size_t>(length));
+        connection.output += body;
+    }
+
+    // Writes as much pending output as the socket takes; true once all of it is sent.
+    // A failed socket is marked with written = SIZE_MAX.
+    bool writePending(Connection& connection) {
+        while (connection.written < connection.output.size()) {
+            ssize_t n = write(connection.fd, connection.output.data() + connection.written,
+                              connection.output.size() - connection.written);
+            if (n > 0) {
+                connection.written += static_cast<size_t>(n);
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return false;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                connection.written = SIZE_MAX;
+                return false;
+            }
         }
-    } else {
-        cout << "No soldier logged in.\n";
+        connection.output.clear();
+        connection.written = 0;
+        return true;
+    }
+
+    void close(Connection& connection) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+        ::close(connection.fd);
+        {
+            lock_guard<mutex> guard(queueLock);
+            connections.erase(&connection);
+        }
+        delete &connection;
+    }
+};
+
+atomic<int> CommandServer::stopFd{-1};
+
+// Minimal client for --connect: sends each stdin line as a request and prints the body
+// of each response
+int runClient(const string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path too long: " << path << "\n";
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        cerr << "Cannot connect to " << path << ": " << strerror(errno) << "\n";
+        if (fd >= 0) ::close(fd);
+        return 1;
+    }
+
+    FILE* server = fdopen(fd, "r+");
+    string line;
+    int status = 0;
+    char header[64];
+    while (getline(cin, line)) {
+        line += '\n';
+        if (fwrite(line.data(), 1, line.size(), server) != line.size() || fflush(server) != 0) break;
+        if (line == "exit\n") break;
+        if (!fgets(header, sizeof(header), server)) break;
+        size_t length = 0;
+        bool ok = strncmp(header, "OK ", 3) == 0;
+        if (!ok && strncmp(header, "ERR ", 4) != 0) break;
+        length = strtoull(header + (ok ? 3 : 4), nullptr, 10);
+        vector<char> body(length);
+        if (length && fread(body.data(), 1, length, server) != length) break;
+        cout.write(body.data(), static_cast<streamsize>(length));
+        if (!ok) status = 1;
     }
+    fclose(server);
+    return status;
 }
+#endif
 
+// Define MILITARY_NO_MAIN to reuse this file from another program (e.g. Military_benchmark.cpp)
+#ifndef MILITARY_NO_MAIN
+int main(int argc, char* argv[]) {
+    MilitaryManagementSystem system;
+    string snapshotPath, journalPath, statsPath;
+    int arg = 1;
 
-void MilitaryManagementSystem::run() {
-    string command;
-    while (true) {
-        if (currentUser) {
-            cout << "\n[Logged in as: " << currentUser->getId() << "]\n";
+    // --snapshot <file>  start from a saved snapshot instead of the defaults
+    // --journal <file>   replay changes made since that snapshot and log new ones
+    // --stats-file <file> write per-command latency statistics on exit
+    // --audit <file>     record every access decision there (rotated to <file>.1, .2, ...)
+    // --serve <socket>   serve clients on a Unix domain socket instead of the console
+    // --workers <n>      worker threads for --serve (default: one per core)
+    // --client-files <dir> directory --serve clients' report files are confined to (default: none)
+    // --connect <socket> act as a client of a running server, reading commands from stdin
+    string servePath, connectPath, auditPath;
+    size_t workers = thread::hardware_concurrency();
+    while (arg + 1 < argc && string(argv[arg]) != "--batch") {
+        string option = argv[arg];
+        if (option == "--connect") {
+            connectPath = argv[arg + 1];
+        } else if (option == "--serve") {
+            servePath = argv[arg + 1];
+        } else if (option == "--workers") {
+            workers = strtoul(argv[arg + 1], nullptr, 10);
+        } else if (option == "--client-files") {
+            system.setClientFileDir(argv[arg + 1]);
+        } else if (option == "--snapshot") {
+            snapshotPath = argv[arg + 1];
+        } else if (option == "--journal") {
+            journalPath = argv[arg + 1];
+        } else if (option == "--stats-file") {
+            statsPath = argv[arg + 1];
+        } else if (option == "--audit") {
+            auditPath = argv[arg + 1];
         } else {
-            cout << "\n[No soldier logged in]\n";
+            cerr << "Unknown option: " << option << "\n";
+            return 1;
         }
+        arg += 2;
+    }
+    if (arg < argc && string(argv[arg]) != "--batch") {
+        cerr << "Unknown option or missing value: " << argv[arg] << "\n";
+        return 1;
+    }
+#ifdef _WIN32
+    if (!servePath.empty() || !connectPath.empty()) {
+        cerr << "--serve and --connect need Unix domain sockets, which this build does not support.\n";
+        return 1;
+    }
+#else
+    if (!connectPath.empty()) return runClient(connectPath);
+#endif
+    if (!auditPath.empty() && !AuditTrail::instance().open(auditPath)) {
+        cerr << "Cannot open audit file: " << auditPath << "\n";
+        return 1;
+    }
+    if (!snapshotPath.empty() && !system.loadSnapshot(snapshotPath)) return 1;
+    if (!journalPath.empty() && !system.openJournal(journalPath)) return 1;
 
-        cout << "Enter command (type 'help' for available commands): ";
-        cin >> command;
+    int status = 0;
+    // --batch <file>... runs each script (use - for stdin) instead of the interactive prompt
+    if (arg < argc && string(argv[arg]) == "--batch") {
+        static char outputBuffer[1 << 16];
+        ios::sync_with_stdio(false);
+        cout.rdbuf()->pubsetbuf(outputBuffer, sizeof(outputBuffer));
+        cin.tie(nullptr);
 
-        if (command == "help") {
-            showHelp();
-        } else if (command == "login") {
-            if (currentUser) {
-                cout << "A soldier is already logged in. Please logout first.\n";
-            } else {
-                string soldierId;
-                cout << "Enter Soldier ID to login: ";
-                cin >> soldierId;
-                if (login(soldierId)) {
-                    cout << "Logged in successfully.\n";
-                } else {
-                    cout << "Soldier not found.\n";
-                }
-            }
-        } else if (command == "logout") {
-            if (currentUser) {
-                logout();
+        for (int i = arg + 1; i < argc; ++i) {
+            string path = argv[i];
+            MilitaryManagementSystem::BatchResult result;
+            if (path == "-") {
+                result = system.runBatch(cin);
             } else {
-                cout << "No soldier is currently logged in.\n";
-            }
-        } else if (command == "create_soldier") {
-            createSoldier();
-        } else if (command == "add_weapon") {
-            addWeaponManually();
-        } else if (command == "add_warzone") {
-            addWarzoneManually();
-        } else if (command == "assign_weapon") {
-            assignWeaponToSoldier();
-        } else if (command == "assign_warzone") {
-            assignWarzoneToSoldier();
-        } else if (command == "display_soldier") {
-            displaySoldierInfo();
-        } else if (command == "view_inventory") {
-            if (currentUser) {
-                if (inventory.canAccess(currentUser)) {
-                    inventory.displayInfo();
-                } else {
-                    cout << "Access denied to inventory.\n";
+                ifstream script(path);
+                if (!script) {
+                    cerr << "Cannot open batch file: " << path << "\n";
+                    status = 1;
+                    continue;
                 }
-            } else {
-                cout << "No soldier logged in.\n";
+                result = system.runBatch(script);
             }
-        } else if (command == "exit") {
-            cout << "Exiting system...\n";
-            break;
-        } else {
-            cout << "Unknown command.\n";
+            cout << "Batch " << path << ": " << (result.succeeded + result.failed) << " commands, "
+                 << result.succeeded << " succeeded, " << result.failed << " failed\n";
+            if (result.failed) status = 1;
         }
+        cout.flush();
+#ifndef _WIN32
+    } else if (!servePath.empty()) {
+        if (!CommandServer(system, workers).run(servePath)) status = 1;
+#endif
+    } else {
+        system.run();
     }
-}
-
 
-int main() {
-    MilitaryManagementSystem system;
-    system.run();
-    return 0;
+    if (!statsPath.empty() && !system.writeStats(statsPath)) {
+        cerr << "Cannot write stats file: " << statsPath << "\n";
+    }
+    AuditTrail::instance().close();
+    return status;
 }
+#endif
@@ -0,0 +1,543 @@
+// Military Management System - Self-checks
+// Build: g++ -std=c++17 -Wall -Wextra -O2 -pthread Military_selftest.cpp -o Military_selftest
+// Usage: Military_selftest [--seed 1] [--filter name]
+// Checks the indexed structures against brute force and the command server against
+// direct execution, on random data. Prints one line per check; exits non-zero if any
+// check fails. Under ThreadSanitizer the server check must also report no races:
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -pthread Military_selftest.cpp -o Military_selftest_tsan
+//   ./Military_selftest_tsan --filter server_framing
+#define MILITARY_NO_MAIN
+#include "Military_project_endofsemester.cpp"
+
+#include <cstdarg>
+#include <csignal>
+#include <random>
+
+// ------------------- Reporting -------------------
+static int failures = 0;
+
+// Prints the first few mismatches of a check; the rest are only counted
+bool fail(const char* check, const char* format, ...) {
+    if (++failures <= 10) {
+        printf("FAIL %s: ", check);
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("\n");
+    }
+    return false;
+}
+
+struct CheckOptions {
+    unsigned seed = 1;
+    string filter;
+};
+
+// Runs one named check unless filtered out
+template <typename Check>
+void run(const CheckOptions& options, const string& name, Check check) {
+    if (!options.filter.empty() && name.find(options.filter) == string::npos) return;
+    int before = failures;
+    size_t cases = check(options.seed);
+    printf("%s %s (%zu cases)\n", failures == before ? "ok  " : "FAIL", name.c_str(), cases);
+    fflush(stdout);
+}
+
+// ------------------- Checks -------------------
+// Nearest-zone and radius queries against a linear scan, with random edits and
+// removals between queries and positions on the poles and the date line
+size_t checkWarzoneMap(unsigned seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> unit(0, 1);
+    auto latitude = [&] { return asin(2 * unit(rng) - 1) * 180 / WarzoneMap::PI; };
+    size_t cases = 0;
+
+    for (int round = 0; round < 20; ++round) {
+        WarzoneMap map;
+        size_t zones = 1 + rng() % 2000;
+        vector<double> lat(zones, NAN), lon(zones, NAN);
+        vector<int> level(zones, 1);
+        auto place = [&](size_t i) {
+            if (rng() % 20 == 0) {
+                lat[i] = lon[i] = NAN;  // removes the zone
+            } else {
+                lat[i] = rng() % 10 == 0 ? (rng() % 2 ? 90 : -90) * unit(rng) : latitude();
+                lon[i] = rng() % 50 == 0 ? (rng() % 2 ? 180 : -180) : 360 * unit(rng) - 180;
+            }
+            level[i] = 1 + static_cast<int>(rng() % ACCESS_LEVEL_COUNT);
+            map.set(static_cast<uint32_t>(i), static_cast<AccessLevel>(level[i]), lat[i], lon[i]);
+        };
+        for (size_t i = 0; i < zones; ++i) place(i);
+
+        for (int query = 0; query < 200; ++query, ++cases) {
+            if (rng() % 3 == 0) {
+                for (size_t edits = rng() % 500; edits > 0; --edits) place(rng() % zones);
+            }
+            double qLat = latitude(), qLon = 360 * unit(rng) - 180;
+            int clearance = 1 + static_cast<int>(rng() % ACCESS_LEVEL_COUNT);
+            size_t k = rng() % 2 ? 1 + rng() % 10 : SIZE_MAX;
+            double maxKm = rng() % 2 ? 3000 * unit(rng) : (k == SIZE_MAX ? 500 : INFINITY);
+
+            vector<WarzoneMap::Hit> hits = map.nearest(qLat, qLon, static_cast<AccessLevel>(clearance), k, maxKm);
+            vector<double> expected;
+            for (size_t i = 0; i < zones; ++i) {
+                if (isnan(lat[i]) || level[i] > clearance) continue;
+                double km = WarzoneMap::distanceKm(qLat, qLon, lat[i], lon[i]);
+                if (km <= maxKm) expected.push_back(km);
+            }
+            sort(expected.begin(), expected.end());
+            if (expected.size() > k) expected.resize(k);
+
+            if (hits.size() != expected.size()) {
+                fail("warzone_map", "round %d query %d: %zu hits, expected %zu (k=%zu, maxKm=%.1f)", round, query,
+                     hits.size(), expected.size(), k, maxKm);
+                continue;
+            }
+            for (size_t i = 0; i < hits.size(); ++i) {
+                double km = WarzoneMap::distanceKm(qLat, qLon, lat[hits[i].slot], lon[hits[i].slot]);
+                if (fabs(hits[i].km - expected[i]) > 1e-3 || fabs(km - hits[i].km) > 1e-3 ||
+                    level[hits[i].slot] > clearance) {
+                    fail("warzone_map", "round %d query %d: hit %zu is %.3f km, expected %.3f km", round, query, i,
+                         hits[i].km, expected[i]);
+                    break;
+                }
+            }
+        }
+    }
+    return cases;
+}
+
+// Soldier queries against a linear filter. Rank and experience values run past the
+// indexed ranges so the overflow buckets are used; soldiers are replaced by ID and
+// promoted between queries so the incremental index updates are covered too.
+size_t checkSoldierQuery(unsigned seed) {
+    static const char* specializations[] = { "Infantry", "Medic", "Sniper", "Engineer", "Pilot" };
+    mt19937 rng(seed);
+    auto between = [&](int lo, int hi) { return lo + static_cast<int>(rng() % static_cast<unsigned>(hi - lo + 1)); };
+    auto randomSoldier = [&](size_t id) {
+        MilitaryRank rank("Rank", between(MIN_RANK_LEVEL - 3, MAX_RANK_LEVEL + 3),
+                          static_cast<AccessLevel>(between(1, ACCESS_LEVEL_COUNT)),
+                          static_cast<MilitaryBranch>(between(0, BRANCH_COUNT - 1)));
+        return Soldier("S" + to_string(id), "First", "Last", rank, specializations[rng() % 5], between(-5, 60));
+    };
+    auto matches = [](const Soldier& s, const SoldierQuery& q) {
+        const MilitaryRank& rank = s.getRank();
+        int access = static_cast<int>(rank.getAccessLevel());
+        return (q.branches == 0 || (q.branches >> static_cast<int>(rank.getBranch()) & 1)) &&
+               access >= q.minAccess && access <= q.maxAccess &&
+               rank.getRankLevel() >= q.minRank && rank.getRankLevel() <= q.maxRank &&
+               s.getExperienceYears() >= q.minExperience && s.getExperienceYears() <= q.maxExperience &&
+               (q.specialization.empty() || s.getSpecialization() == q.specialization);
+    };
+    size_t cases = 0;
+
+    for (int round = 0; round < 10; ++round) {
+        SoldierStore store;
+        size_t soldiers = 1 + rng() % 3000;
+        for (size_t i = 0; i < soldiers; ++i) store.add(randomSoldier(i));
+
+        for (int query = 0; query < 300; ++query, ++cases) {
+            if (rng() % 3 == 0) {
+                for (size_t edits = rng() % 50; edits > 0; --edits) {
+                    size_t id = rng() % (soldiers + 20);  // mostly replacements, a few new soldiers
+                    if (rng() % 2) {
+                        store.add(randomSoldier(id));
+                    } else if (id < store.size()) {
+                        store.promote(static_cast<SoldierHandle>(id), "Promoted", between(MIN_RANK_LEVEL - 3, MAX_RANK_LEVEL + 3));
+                    }
+                }
+            }
+            SoldierQuery q;
+            if (rng() % 2) q.branches = static_cast<uint32_t>(rng() % (1u << BRANCH_COUNT));
+            if (rng() % 2) q.minAccess = between(1, ACCESS_LEVEL_COUNT);
+            if (rng() % 2) q.maxAccess = between(1, ACCESS_LEVEL_COUNT);
+            if (rng() % 2) q.minRank = between(MIN_RANK_LEVEL - 5, MAX_RANK_LEVEL + 5);
+            if (rng() % 2) q.maxRank = between(MIN_RANK_LEVEL - 5, MAX_RANK_LEVEL + 5);
+            if (rng() % 2) q.minExperience = between(-10, 65);
+            if (rng() % 2) q.maxExperience = between(-10, 65);
+            if (rng() % 3 == 0) q.specialization = rng() % 6 ? specializations[rng() % 5] : "Chaplain";
+
+            vector<SoldierHandle> found = store.query(q);
+            vector<SoldierHandle> expected;
+            for (SoldierHandle h = 0; h < store.size(); ++h) {
+                if (matches(store.get(h), q)) expected.push_back(h);
+            }
+            if (found != expected) {
+                fail("soldier_query", "round %d query %d: %zu matches, expected %zu", round, query, found.size(),
+                     expected.size());
+            }
+        }
+    }
+    return cases;
+}
+
+// Deployment plans after random warzone changes, deploys, placements, withdrawals and
+// replaced soldier records. Every plan must be valid, match the moves reported for it
+// and deploy as many soldiers as a soldier-by-soldier matching does. Warzone counts run
+// past 64 so the class masks grow.
+size_t checkDeployments(unsigned seed) {
+    static const char* skillNames[] = { "Medic", "Pilot", "Sniper", "Diver" };
+    mt19937 rng(seed);
+    auto randomAccess = [&] { return static_cast<AccessLevel>(1 + rng() % ACCESS_LEVEL_COUNT); };
+    auto randomSoldier = [&](size_t id) {
+        Soldier soldier("S" + to_string(id), "First", "Last", MilitaryRank("Rank", 1, randomAccess(), MilitaryBranch::ARMY));
+        for (size_t k = rng() % 3; k > 0; --k) soldier.addSkill(skillNames[rng() % 4]);
+        return soldier;
+    };
+    auto randomZone = [&] {
+        DeploymentScheduler::Zone zone;
+        zone.access = randomAccess();
+        zone.capacity = rng() % 4 == 0 ? 0 : static_cast<uint32_t>(rng() % 6);
+        for (size_t k = rng() % 2; k > 0; --k) zone.skills.push_back(SkillNames::intern(skillNames[rng() % 4]));
+        return zone;
+    };
+    size_t cases = 0;
+
+    for (int round = 0; round < 30; ++round) {
+        SoldierStore store;
+        size_t soldiers = 1 + rng() % 300, maxZones = 1 + rng() % 100;
+        for (size_t i = 0; i < soldiers; ++i) store.add(randomSoldier(i));
+        DeploymentScheduler scheduler;
+        for (uint32_t z = 0, initial = static_cast<uint32_t>(1 + rng() % maxZones); z < initial; ++z) scheduler.setZone(z, randomZone());
+
+        auto qualifies = [&](SoldierHandle h, uint32_t slot) {
+            SkillList skills;
+            store.copySkills(h, skills);
+            return DeploymentScheduler::qualifies(store.accessLevel(h), skills, scheduler.zone(slot));
+        };
+        // Most pool soldiers a soldier-by-soldier augmenting-path matching can deploy
+        auto bestCount = [&] {
+            size_t zones = scheduler.zoneCount();
+            vector<vector<SoldierHandle>> holders(zones);
+            vector<char> visited;
+            function<bool(SoldierHandle)> seat = [&](SoldierHandle h) {
+                for (uint32_t z = 0; z < zones; ++z) {
+                    if (visited[z] || !qualifies(h, z)) continue;
+                    visited[z] = 1;
+                    uint32_t capacity = scheduler.zone(z).capacity;
+                    if (capacity == 0 || holders[z].size() < capacity) {
+                        holders[z].push_back(h);
+                        return true;
+                    }
+                    for (SoldierHandle& other : holders[z]) {
+                        if (seat(other)) {
+                            other = h;
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            };
+            size_t seated = 0;
+            for (SoldierHandle h = 0; h < soldiers; ++h) {
+                if (scheduler.state(h) == DeploymentScheduler::OFF) continue;
+                visited.assign(zones, 0);
+                if (seat(h)) ++seated;
+            }
+            return seated;
+        };
+
+        vector<uint32_t> states(soldiers, DeploymentScheduler::OFF);
+        for (int step = 0; step < 100; ++step, ++cases) {
+            DeploymentScheduler::Moves moves;
+            SoldierHandle h = static_cast<SoldierHandle>(rng() % soldiers);
+            int op = static_cast<int>(rng() % 5);
+            if (op == 0) {
+                uint32_t slot = static_cast<uint32_t>(rng() % min<size_t>(maxZones, scheduler.zoneCount() + 1));
+                scheduler.setZone(slot, randomZone());
+                scheduler.rebalance(store, moves);
+            } else if (op == 1) {
+                vector<SoldierHandle> added;
+                for (size_t n = rng() % 3 ? rng() % 20 : soldiers; n > 0; --n) added.push_back(static_cast<SoldierHandle>(rng() % soldiers));
+                scheduler.solve(added, store, moves);
+            } else if (op == 2) {
+                scheduler.withdraw(h, store, moves);
+            } else if (op == 3) {
+                uint32_t slot = static_cast<uint32_t>(rng() % scheduler.zoneCount());
+                if (qualifies(h, slot)) scheduler.place(h, slot, store, moves);
+            } else {
+                store.add(randomSoldier(h));
+                scheduler.replanSoldier(h, store, moves);
+            }
+
+            for (const auto& [moved, state] : moves) states[moved] = state;
+            vector<uint32_t> loads(scheduler.zoneCount(), 0);
+            size_t waiting = 0, deployed = 0;
+            bool valid = true;
+            for (SoldierHandle s = 0; s < soldiers && valid; ++s) {
+                uint32_t state = scheduler.state(s);
+                if (state != states[s]) {
+                    valid = fail("deployments", "round %d step %d: soldier %u moved without a reported move", round, step, s);
+                } else if (state == DeploymentScheduler::WAITING) {
+                    ++waiting;
+                } else if (state != DeploymentScheduler::OFF) {
+                    ++loads[state];
+                    ++deployed;
+                    if (!qualifies(s, state)) valid = fail("deployments", "round %d step %d: soldier %u not qualified for warzone %u", round, step, s, state);
+                }
+            }
+            for (uint32_t z = 0; z < scheduler.zoneCount() && valid; ++z) {
+                uint32_t capacity = scheduler.zone(z).capacity;
+                if (loads[z] != scheduler.load(z) || (capacity && loads[z] > capacity)) {
+                    valid = fail("deployments", "round %d step %d: warzone %u holds %u, counted %u, capacity %u", round, step, z, loads[z],
+                                 scheduler.load(z), capacity);
+                }
+            }
+            if (valid && waiting != scheduler.waitingCount()) {
+                valid = fail("deployments", "round %d step %d: %zu waiting, counted %zu", round, step, waiting, scheduler.waitingCount());
+            }
+            size_t best = valid ? bestCount() : deployed;
+            if (deployed != best) fail("deployments", "round %d step %d (op %d): %zu deployed, %zu possible", round, step, op, deployed, best);
+            if (!valid || deployed != best) break;
+        }
+    }
+    return cases;
+}
+
+#ifndef _WIN32
+// Reads framed responses ("OK <n>\n" / "ERR <n>\n" + n bytes) from a blocking socket
+class ResponseReader {
+public:
+    explicit ResponseReader(int fd) : fd(fd) {}
+
+    // False at end of stream or on a malformed header
+    bool next(bool& ok, string& body) {
+        size_t newline;
+        while ((newline = buffered.find('\n')) == string::npos) {
+            if (!fill()) return false;
+        }
+        string header = buffered.substr(0, newline);
+        buffered.erase(0, newline + 1);
+        ok = header.compare(0, 3, "OK ") == 0;
+        if (!ok && header.compare(0, 4, "ERR ") != 0) return false;
+        size_t length = strtoull(header.c_str() + (ok ? 3 : 4), nullptr, 10);
+        while (buffered.size() < length) {
+            if (!fill()) return false;
+        }
+        body = buffered.substr(0, length);
+        buffered.erase(0, length);
+        return true;
+    }
+
+    bool atEnd() { return buffered.empty() && !fill(); }
+
+private:
+    int fd;
+    string buffered;
+
+    bool fill() {
+        char chunk[4096];
+        ssize_t n;
+        do {
+            n = read(fd, chunk, sizeof(chunk));
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return false;
+        buffered.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+};
+
+int connectTo(const string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    for (int attempt = 0; attempt < 500; ++attempt) {  // the server may still be starting
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+            timeval timeout{ 60, 0 };  // a stalled server fails the check instead of hanging it
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            return fd;
+        }
+        if (fd >= 0) ::close(fd);
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return -1;
+}
+
+// Sends text in random pieces; false once the server has hung up
+bool sendInPieces(int fd, const string& text, mt19937& rng) {
+    for (size_t at = 0; at < text.size();) {
+        size_t piece = min(text.size() - at, rng() % 2 ? 1 + rng() % 16 : 1 + rng() % 8192);
+        ssize_t n = send(fd, text.data() + at, piece, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        at += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Several clients pipeline read-only commands to a CommandServer, written in random
+// pieces so that requests are split across reads. Every response must be framed
+// correctly, arrive in order and match what executeLine gives on an identical system.
+// One more client sends an oversized request and must get an error and a hang-up.
+// Another pipelines requests with large answers without reading them: the server must
+// stop taking its input once answers pile up, and still answer all of it in order once
+// the client reads.
+size_t checkServerFraming(unsigned seed) {
+    const size_t clients = 8, requestsPerClient = 300, soldiers = 50;
+    auto setUp = [&](MilitaryManagementSystem& system) {
+        for (size_t i = 0; i < soldiers; ++i) {
+            MilitaryRank rank("Sergeant", 1 + static_cast<int>(i % 20), static_cast<AccessLevel>(1 + i % 4),
+                              static_cast<MilitaryBranch>(i % 6));
+            system.addSoldier(Soldier("S" + to_string(i), "First", "Last", rank, "Infantry", static_cast<int>(i % 30)));
+        }
+    };
+    static const char* commands[] = { "display_soldier", "view_inventory", "find_soldiers rank=5..15",
+                                      "find_soldiers branch=NAVY access=SECRET..", "nearby_warzones W1 3",
+                                      "logout", "no_such_command", "", "# comment" };
+
+    struct Client {
+        string requests;                       // everything the client sends, "exit" last
+        vector<pair<bool, string>> expected;   // responses, in order
+        vector<pair<bool, string>> received;
+        bool hungUp = false;
+    };
+    vector<Client> work(clients);
+    auto reference = make_unique<MilitaryManagementSystem>();
+    setUp(*reference);
+    mt19937 rng(seed);
+    for (Client& client : work) {
+        Session session;
+        string output;
+        for (size_t i = 0; i < requestsPerClient; ++i) {
+            string line = rng() % 8 == 0 ? "login S" + to_string(rng() % (soldiers + 5)) : commands[rng() % 9];
+            bool ok = reference->executeLine(line, session, output);
+            client.expected.emplace_back(ok, output);
+            client.requests += line + (rng() % 4 == 0 ? "\r\n" : "\n");
+        }
+        client.requests += rng() % 2 ? "exit\r\n" : "exit\n";
+    }
+
+    auto served = make_unique<MilitaryManagementSystem>();
+    setUp(*served);
+    string path = "/tmp/military_selftest_" + to_string(getpid()) + ".sock";
+    thread server([&] { CommandServer(*served, 4).run(path); });
+
+    vector<thread> threads;
+    for (size_t c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            Client& client = work[c];
+            int fd = connectTo(path);
+            if (fd < 0) return;
+            mt19937 pieces(seed + static_cast<unsigned>(c));
+            thread writer([&] { sendInPieces(fd, client.requests, pieces); });
+            ResponseReader reader(fd);
+            bool ok;
+            string body;
+            while (client.received.size() < client.expected.size() && reader.next(ok, body)) {
+                client.received.emplace_back(ok, body);
+            }
+            client.hungUp = reader.atEnd();
+            writer.join();
+            ::close(fd);
+        });
+    }
+    bool oversizedRejected = false;
+    threads.emplace_back([&] {
+        int fd = connectTo(path);
+        if (fd < 0) return;
+        mt19937 pieces(seed);
+        sendInPieces(fd, string(64 * 1024 + 100, 'x'), pieces);  // past the server's 64 KiB request limit
+        ResponseReader reader(fd);
+        bool ok;
+        string body;
+        oversizedRejected = reader.next(ok, body) && !ok && body == "Request too long.\n" && reader.atEnd();
+        ::close(fd);
+    });
+
+    // Each unit is a large answer plus a cheap padding comment, so request bytes far exceed
+    // what the socket buffers and the server's input limit can absorb without running them
+    const size_t stalledUnits = 2000;
+    const string stalledLine = "find_soldiers rank=1..20", padding = "# " + string(2000, 'x');
+    Session stalledSession;
+    string loginAnswer, stalledAnswer, paddingAnswer;
+    bool loginOk = reference->executeLine("login S3", stalledSession, loginAnswer);
+    bool stalledOk = reference->executeLine(stalledLine, stalledSession, stalledAnswer);
+    bool paddingOk = reference->executeLine(padding, stalledSession, paddingAnswer);
+    bool stalledHeldBack = false;
+    size_t stalledAnswered = 0;
+    threads.emplace_back([&] {
+        int fd = connectTo(path);
+        if (fd < 0) return;
+        string requests = "login S3\n";
+        for (size_t i = 0; i < stalledUnits; ++i) requests += stalledLine + "\n" + padding + "\n";
+        requests += "exit\n";
+        atomic<bool> sentAll{ false };
+        thread writer([&] {
+            for (size_t at = 0; at < requests.size();) {
+                ssize_t n = send(fd, requests.data() + at, requests.size() - at, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return;
+                at += static_cast<size_t>(n);
+            }
+            sentAll = true;
+        });
+        this_thread::sleep_for(chrono::milliseconds(500));
+        stalledHeldBack = !sentAll;
+        ResponseReader reader(fd);
+        bool ok;
+        string body;
+        bool loggedIn = reader.next(ok, body) && ok == loginOk && body == loginAnswer;
+        while (loggedIn && stalledAnswered < 2 * stalledUnits && reader.next(ok, body)) {
+            bool padded = stalledAnswered % 2 == 1;
+            if (ok != (padded ? paddingOk : stalledOk) || body != (padded ? paddingAnswer : stalledAnswer)) break;
+            ++stalledAnswered;
+        }
+        writer.join();
+        ::close(fd);
+    });
+    for (thread& t : threads) t.join();
+    raise(SIGTERM);  // run() returns once the signal reaches its event loop
+    server.join();
+
+    size_t cases = 0;
+    for (size_t c = 0; c < clients; ++c) {
+        const Client& client = work[c];
+        for (size_t i = 0; i < client.expected.size(); ++i, ++cases) {
+            if (i >= client.received.size()) {
+                fail("server_framing", "client %zu: %zu of %zu responses", c, client.received.size(), client.expected.size());
+                break;
+            }
+            if (client.received[i] != client.expected[i]) {
+                fail("server_framing", "client %zu response %zu: got %s \"%.40s\", expected %s \"%.40s\"", c, i,
+                     client.received[i].first ? "OK" : "ERR", client.received[i].second.c_str(),
+                     client.expected[i].first ? "OK" : "ERR", client.expected[i].second.c_str());
+                break;
+            }
+        }
+        if (!client.hungUp) fail("server_framing", "client %zu: connection still open after exit", c);
+    }
+    if (!oversizedRejected) fail("server_framing", "oversized request was not rejected and closed");
+    if (!stalledHeldBack) fail("server_framing", "server kept reading from a client that does not read its answers");
+    if (stalledAnswered != 2 * stalledUnits) {
+        fail("server_framing", "stalled client: %zu of %zu responses", stalledAnswered, 2 * stalledUnits);
+    }
+    return cases + 2;
+}
+#endif
+
+// ------------------- Main -------------------
+int main(int argc, char* argv[]) {
+    CheckOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "--seed") {
+            options.seed = static_cast<unsigned>(stoul(value));
+        } else if (flag == "--filter") {
+            options.filter = value;
+        } else {
+            cerr << "Unknown option: " << flag << "\n";
+            return 1;
+        }
+    }
+
+    run(options, "warzone_map", checkWarzoneMap);
+    run(options, "soldier_query", checkSoldierQuery);
+    run(options, "deployments", checkDeployments);
+#ifndef _WIN32
+    run(options, "server_framing", checkServerFraming);
+#endif
+    if (failures) printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -90,12 +90,12 @@ public:
 class Unit {
 private:
     string unitName;
-    unique_ptr<Soldier> commander;  // Using smart pointer
+    Soldier* commander = nullptr;  // Not owned: the commander is usually also a member
     set<Soldier*> members;
 public:
     Unit(string name) : unitName(name) {}
 
-    void setCommander(Soldier* soldier) { commander.reset(soldier); }  // Assign commander
+    void setCommander(Soldier* soldier) { commander = soldier; }  // Assign commander
 
     void addMember(Soldier* soldier) { members.insert(soldier); }
 